@@ -0,0 +1,309 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Benchmark.hpp"
+#include "DrawProgram.hpp"
+#include "ThemeCache.hpp"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts every allocation made through operator new in the benchmark executable. The array and nothrow
+// forms end up calling this one.
+static std::atomic<uint64_t> numAllocations { 0 };
+
+void* operator new (std::size_t size) {
+    numAllocations.fetch_add (1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc (size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc ();
+}
+
+void operator delete (void* ptr) noexcept { std::free (ptr); }
+void operator delete (void* ptr, std::size_t size) noexcept { std::free (ptr); }
+
+namespace rack_themer {
+    /*
+     * Gives the benchmarks access to the SVG internals they time.
+     */
+    struct SvgBenchmarks {
+        static int getNumVisibleShapes (const ThemeableSvg& svg) {
+            auto numShapes = 0;
+            for (const auto& shape : svg.shapes) {
+                if (shape.visible && shape.numPaths > 0)
+                    numShapes++;
+            }
+
+            return numShapes;
+        }
+
+        static int computeWindings (const ThemeableSvg& svg) {
+            auto numHoles = 0;
+            for (const auto& shape : svg.shapes) {
+                for (auto pathIndex = shape.firstPath; pathIndex < shape.firstPath + shape.numPaths; pathIndex++) {
+                    auto winding = shape.evenOdd
+                        ? svg.getEvenOddWinding (shape, pathIndex)
+                        : svg.getNonZeroWinding (pathIndex);
+
+                    if (winding == NVG_HOLE)
+                        numHoles++;
+                }
+            }
+
+            return numHoles;
+        }
+    };
+
+namespace benchmark {
+    uint64_t getNumAllocations () { return numAllocations.load (std::memory_order_relaxed); }
+
+    /*
+     * Recording backend
+     */
+    static RecordingBackend* getBackend (void* userPtr) { return static_cast<RecordingBackend*> (userPtr); }
+
+    static void recordCall (RecordingBackend* backend, RecordedCallKind kind, int numPaths, int numVertices) {
+        if (backend->recordCalls)
+            backend->calls.push_back ({ kind, rack::system::getNanoseconds (), numPaths, numVertices });
+    }
+
+    static int getNumVertices (const NVGpath* paths, int numPaths, bool fill) {
+        auto numVertices = 0;
+        for (auto i = 0; i < numPaths; i++)
+            numVertices += (fill ? paths [i].nfill : 0) + paths [i].nstroke;
+
+        return numVertices;
+    }
+
+    static int renderCreate (void* userPtr) { return 1; }
+
+    static int renderCreateTexture (void* userPtr, int type, int w, int h, int imageFlags, const unsigned char* data) {
+        auto backend = getBackend (userPtr);
+        auto image = backend->nextTexture++;
+        backend->textureSizes [image] = { w, h };
+        return image;
+    }
+
+    static int renderDeleteTexture (void* userPtr, int image) { return getBackend (userPtr)->textureSizes.erase (image) > 0 ? 1 : 0; }
+    static int renderUpdateTexture (void* userPtr, int image, int x, int y, int w, int h, const unsigned char* data) { return 1; }
+
+    static int renderGetTextureSize (void* userPtr, int image, int* w, int* h) {
+        auto backend = getBackend (userPtr);
+        auto iter = backend->textureSizes.find (image);
+        if (iter == backend->textureSizes.end ())
+            return 0;
+
+        *w = iter->second.first;
+        *h = iter->second.second;
+        return 1;
+    }
+
+    static void renderViewport (void* userPtr, float width, float height, float devicePixelRatio) { }
+    static void renderCancel (void* userPtr) { }
+
+    static void renderFlush (void* userPtr) {
+        auto backend = getBackend (userPtr);
+        backend->stats.numFlushes++;
+        recordCall (backend, RecordedCallKind::Flush, 0, 0);
+    }
+
+    static void renderFill (void* userPtr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+                            float fringe, const float* bounds, const NVGpath* paths, int numPaths) {
+        auto backend = getBackend (userPtr);
+        auto numVertices = getNumVertices (paths, numPaths, true);
+        backend->stats.numFills++;
+        backend->stats.numPaths += numPaths;
+        backend->stats.numVertices += numVertices;
+        recordCall (backend, RecordedCallKind::Fill, numPaths, numVertices);
+    }
+
+    static void renderStroke (void* userPtr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+                              float fringe, float strokeWidth, const NVGpath* paths, int numPaths) {
+        auto backend = getBackend (userPtr);
+        auto numVertices = getNumVertices (paths, numPaths, false);
+        backend->stats.numStrokes++;
+        backend->stats.numPaths += numPaths;
+        backend->stats.numVertices += numVertices;
+        recordCall (backend, RecordedCallKind::Stroke, numPaths, numVertices);
+    }
+
+    static void renderTriangles (void* userPtr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+                                 const NVGvertex* vertices, int numVertices, float fringe) {
+        auto backend = getBackend (userPtr);
+        backend->stats.numTriangles++;
+        backend->stats.numVertices += numVertices;
+        recordCall (backend, RecordedCallKind::Triangles, 0, numVertices);
+    }
+
+    static void renderDelete (void* userPtr) { }
+
+    NVGcontext* createRecordingContext (RecordingBackend* backend) {
+        auto params = NVGparams ();
+        params.userPtr = backend;
+        params.edgeAntiAlias = 1;
+        params.renderCreate = renderCreate;
+        params.renderCreateTexture = renderCreateTexture;
+        params.renderDeleteTexture = renderDeleteTexture;
+        params.renderUpdateTexture = renderUpdateTexture;
+        params.renderGetTextureSize = renderGetTextureSize;
+        params.renderViewport = renderViewport;
+        params.renderCancel = renderCancel;
+        params.renderFlush = renderFlush;
+        params.renderFill = renderFill;
+        params.renderStroke = renderStroke;
+        params.renderTriangles = renderTriangles;
+        params.renderDelete = renderDelete;
+
+        return nvgCreateInternal (&params);
+    }
+
+    void deleteRecordingContext (NVGcontext* vg) {
+        if (vg != nullptr)
+            nvgDeleteInternal (vg);
+    }
+
+    /*
+     * Benchmarks
+     */
+    // Results the benchmarks compute are stored here, so the work can't be optimized away.
+    static volatile int benchmarkSink = 0;
+
+    static BenchmarkResult makeResult (const char* name, ThemeableSvg& svg, int iterations, int64_t elapsed) {
+        auto result = BenchmarkResult ();
+        result.name = name;
+        result.iterations = iterations;
+        result.numShapes = SvgBenchmarks::getNumVisibleShapes (svg);
+        result.nsPerIteration = iterations > 0 ? static_cast<double> (elapsed) / iterations : 0.0;
+        result.nsPerShape = result.numShapes > 0 ? result.nsPerIteration / result.numShapes : 0.0;
+        return result;
+    }
+
+    BenchmarkResult benchmarkDraw (std::shared_ptr<ThemeableSvg> svg, std::shared_ptr<RackTheme> theme, int iterations) {
+        if (svg == nullptr)
+            return BenchmarkResult ();
+
+        auto backend = RecordingBackend ();
+        auto vg = createRecordingContext (&backend);
+        if (vg == nullptr)
+            return BenchmarkResult ();
+
+        auto size = svg->getSize ();
+        auto drawFrame = [&] {
+            nvgBeginFrame (vg, size.x, size.y, 1.f);
+            svg->draw (vg, theme);
+            nvgEndFrame (vg);
+        };
+
+        // Compile the draw program and warm up the caches before timing anything.
+        drawFrame ();
+        backend.reset ();
+
+        auto startAllocations = getNumAllocations ();
+        auto start = rack::system::getNanoseconds ();
+        for (auto i = 0; i < iterations; i++)
+            drawFrame ();
+        auto elapsed = rack::system::getNanoseconds () - start;
+        auto numFrameAllocations = getNumAllocations () - startAllocations;
+
+        deleteRecordingContext (vg);
+
+        auto result = makeResult ("draw", *svg, iterations, elapsed);
+        if (iterations > 0) {
+            result.drawCallsPerFrame = static_cast<double> (backend.stats.getNumDrawCalls ()) / iterations;
+            result.pathsPerFrame = static_cast<double> (backend.stats.numPaths) / iterations;
+            result.verticesPerFrame = static_cast<double> (backend.stats.numVertices) / iterations;
+            result.allocationsPerFrame = static_cast<double> (numFrameAllocations) / iterations;
+        }
+
+        return result;
+    }
+
+    BenchmarkResult benchmarkThemeBinding (std::shared_ptr<ThemeableSvg> svg, std::shared_ptr<RackTheme> theme, int iterations) {
+        if (svg == nullptr)
+            return BenchmarkResult ();
+
+        auto numCommands = 0;
+        auto start = rack::system::getNanoseconds ();
+        for (auto i = 0; i < iterations; i++) {
+            auto styles = DrawProgram::resolveStyles (*svg, theme.get ());
+            numCommands += DrawProgram::compile (*svg, theme.get (), styles)->getNumCommands ();
+        }
+        auto elapsed = rack::system::getNanoseconds () - start;
+        benchmarkSink = numCommands;
+
+        return makeResult ("theme binding", *svg, iterations, elapsed);
+    }
+
+    BenchmarkResult benchmarkHoleDetection (std::shared_ptr<ThemeableSvg> svg, int iterations) {
+        if (svg == nullptr)
+            return BenchmarkResult ();
+
+        auto numHoles = 0;
+        auto start = rack::system::getNanoseconds ();
+        for (auto i = 0; i < iterations; i++)
+            numHoles += SvgBenchmarks::computeWindings (*svg);
+        auto elapsed = rack::system::getNanoseconds () - start;
+        benchmarkSink = numHoles;
+
+        return makeResult ("hole detection", *svg, iterations, elapsed);
+    }
+
+    std::vector<BenchmarkResult> runBenchmarks (const std::vector<std::string>& svgPaths, const std::string& themePath, int iterations) {
+        auto theme = loadRackTheme (themePath);
+
+        std::vector<BenchmarkResult> results;
+        for (const auto& path : svgPaths) {
+            auto svg = loadSvg (path);
+            if (svg == nullptr)
+                continue;
+
+            // Binding and hole detection are much slower per iteration than drawing.
+            auto slowIterations = std::max (1, iterations / 10);
+            for (auto result : {
+                benchmarkDraw (svg, theme, iterations),
+                benchmarkThemeBinding (svg, theme, slowIterations),
+                benchmarkHoleDetection (svg, slowIterations),
+            }) {
+                result.svgPath = path;
+                results.push_back (result);
+            }
+        }
+
+        return results;
+    }
+
+    std::string formatBenchmarkResults (const std::vector<BenchmarkResult>& results) {
+        auto text = fmt::format (FMT_STRING ("{:<16} {:>8} {:>12} {:>10} {:>10} {:>10} {:>12} {:>10}  {}\n"),
+                                 "benchmark", "shapes", "ns/iter", "ns/shape", "calls", "paths", "vertices", "allocs", "svg");
+
+        for (const auto& result : results) {
+            text += fmt::format (FMT_STRING ("{:<16} {:>8} {:>12.0f} {:>10.1f} {:>10.1f} {:>10.1f} {:>12.1f} {:>10.1f}  {}\n"),
+                                 result.name, result.numShapes, result.nsPerIteration, result.nsPerShape,
+                                 result.drawCallsPerFrame, result.pathsPerFrame, result.verticesPerFrame,
+                                 result.allocationsPerFrame, result.svgPath);
+        }
+
+        return text;
+    }
+}
+}
\ No newline at end of file
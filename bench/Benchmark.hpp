@@ -0,0 +1,115 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <rack.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rack_themer {
+namespace benchmark {
+    enum class RecordedCallKind {
+        Fill,
+        Stroke,
+        Triangles,
+        Flush,
+    };
+
+    struct RecordedCall {
+        RecordedCallKind kind;
+        // In nanoseconds, as returned by rack::system::getNanoseconds.
+        int64_t timestamp;
+        int numPaths;
+        int numVertices;
+    };
+
+    struct RecordingStats {
+        uint64_t numFills = 0;
+        uint64_t numStrokes = 0;
+        uint64_t numTriangles = 0;
+        uint64_t numFlushes = 0;
+        uint64_t numPaths = 0;
+        uint64_t numVertices = 0;
+
+        uint64_t getNumDrawCalls () const { return numFills + numStrokes + numTriangles; }
+    };
+
+    /**
+     * The state of a headless NanoVG context, which tessellates everything as usual but only counts what it would have
+     * rendered. It doesn't need a window or a GPU.
+     */
+    struct RecordingBackend {
+        RecordingStats stats;
+        /** Also log every call, with its timestamp. */
+        bool recordCalls = false;
+        std::vector<RecordedCall> calls;
+
+        std::unordered_map<int, std::pair<int, int>> textureSizes;
+        int nextTexture = 1;
+
+        void reset () {
+            stats = RecordingStats ();
+            calls.clear ();
+        }
+    };
+
+    /** Creates a headless NanoVG context that reports to backend. The backend must outlive the context. */
+    NVGcontext* createRecordingContext (RecordingBackend* backend);
+    void deleteRecordingContext (NVGcontext* vg);
+
+    struct BenchmarkResult {
+        std::string name;
+        std::string svgPath;
+        int iterations = 0;
+        // Only counts the shapes that are drawn.
+        int numShapes = 0;
+
+        double nsPerIteration = 0.0;
+        double nsPerShape = 0.0;
+
+        // Averaged per iteration, as seen by the NanoVG backend. Zero for benchmarks that don't draw.
+        double drawCallsPerFrame = 0.0;
+        double pathsPerFrame = 0.0;
+        double verticesPerFrame = 0.0;
+        // Calls to operator new, averaged per iteration. NanoVG's own mallocs aren't counted.
+        double allocationsPerFrame = 0.0;
+    };
+
+    /** Returns how many times operator new has been called so far by the benchmark executable. */
+    uint64_t getNumAllocations ();
+
+    /** Times drawing the SVG with the given theme into a recording context. */
+    BenchmarkResult benchmarkDraw (std::shared_ptr<ThemeableSvg> svg, std::shared_ptr<RackTheme> theme, int iterations = 1000);
+    /** Times resolving the theme's styles for every shape of the SVG and compiling its draw program. */
+    BenchmarkResult benchmarkThemeBinding (std::shared_ptr<ThemeableSvg> svg, std::shared_ptr<RackTheme> theme, int iterations = 100);
+    /** Times computing the fill winding of every path of the SVG. */
+    BenchmarkResult benchmarkHoleDetection (std::shared_ptr<ThemeableSvg> svg, int iterations = 100);
+
+    /** Runs every benchmark over each SVG, using the given theme. */
+    std::vector<BenchmarkResult> runBenchmarks (const std::vector<std::string>& svgPaths, const std::string& themePath, int iterations = 1000);
+    /** Formats the results as a table, one benchmark per line. */
+    std::string formatBenchmarkResults (const std::vector<BenchmarkResult>& results);
+}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace rack_themer;
+
+static void printUsage () {
+    std::fprintf (stderr, "Usage: rack-themer-bench [--iterations N] <theme.json> <panel.svg>...\n");
+}
+
+int main (int argc, char* argv []) {
+    auto iterations = 1000;
+    std::vector<std::string> paths;
+    for (auto i = 1; i < argc; i++) {
+        if (std::strcmp (argv [i], "--iterations") == 0 && i + 1 < argc)
+            iterations = std::atoi (argv [++i]);
+        else
+            paths.push_back (argv [i]);
+    }
+
+    if (paths.size () < 2 || iterations < 1) {
+        printUsage ();
+        return 1;
+    }
+
+    auto themePath = paths.front ();
+    paths.erase (paths.begin ());
+
+    auto results = benchmark::runBenchmarks (paths, themePath, iterations);
+    if (results.empty ()) {
+        std::fprintf (stderr, "None of the SVGs could be loaded.\n");
+        return 1;
+    }
+
+    std::fputs (benchmark::formatBenchmarkResults (results).c_str (), stdout);
+    return 0;
+}
\ No newline at end of file
@@ -22,4 +22,27 @@
 #error "Only rack_themer.hpp must be included. Including other headers is unsupported."
 #endif
 
-#include <rack.hpp>
\ No newline at end of file
+#include <rack.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace rack_themer {
+    /*
+     * A number that's never reused, unlike an object's address. Copies get a new one, so it keeps identifying the
+     * object it's a member of.
+     */
+    struct UniqueId {
+        uint64_t value;
+
+        UniqueId () : value (next ()) { }
+        UniqueId (const UniqueId&) : UniqueId () { }
+        UniqueId& operator= (const UniqueId&) { return *this; }
+
+      private:
+        static uint64_t next () {
+            static std::atomic<uint64_t> counter { 1 };
+            return counter++;
+        }
+    };
+}
\ No newline at end of file
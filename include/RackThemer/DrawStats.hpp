@@ -0,0 +1,59 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Common.hpp"
+
+#include <rack.hpp>
+
+#include <cstdint>
+
+namespace rack_themer {
+    /**
+     * Counters describing how an SVG has been drawn. They're only updated if the library was built with
+     * RACK_THEMER_STATS defined, and stay at zero otherwise.
+     */
+    struct DrawStats {
+        uint64_t numDraws = 0;
+        uint64_t numShapesDrawn = 0;
+        uint64_t numShapesCulled = 0;
+        /** Shapes left out for being too small to see at the current level of detail. */
+        uint64_t numShapesSkipped = 0;
+        uint64_t numPaths = 0;
+        uint64_t numBeziers = 0;
+        uint64_t numGradientPaints = 0;
+        /** Line crossing tests run to find the windings of even-odd filled paths, when the SVG was loaded. */
+        uint64_t numCrossingTests = 0;
+        /** Total time spent drawing, in nanoseconds. */
+        int64_t drawTime = 0;
+
+        DrawStats& operator+= (const DrawStats& rhs);
+        json_t* toJson () const;
+    };
+
+    /** Returns whether the library was built with draw statistics. */
+    bool isDrawStatsEnabled ();
+    /**
+     * Returns the statistics of every loaded SVG, and of each theme it has been drawn with, as a JSON object.
+     * The caller owns the returned reference.
+     */
+    json_t* getDrawStatsJson ();
+    void resetDrawStats ();
+}
\ No newline at end of file
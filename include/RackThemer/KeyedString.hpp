@@ -22,6 +22,7 @@
 
 #include <functional>
 #include <string>
+#include <string_view>
 
 namespace rack_themer {
     struct ThemeCache;
@@ -38,8 +39,9 @@ namespace rack_themer {
         std::size_t getHash () const { return std::hash<unsigned int> {} (value); }
     };
 
-    KeyedString getKeyedString (const std::string& text);
-    std::string getKeyedStringText (const KeyedString& key);
+    KeyedString getKeyedString (std::string_view text);
+    /** The returned view stays valid for as long as the library is loaded. Invalid keys return an empty view. */
+    std::string_view getKeyedStringText (const KeyedString& key);
 }
 
 template<>
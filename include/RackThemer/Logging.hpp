@@ -58,6 +58,8 @@ namespace logging {
     };
 
     // Logging callback function you provide.
+    // Assets loaded asynchronously or preloaded are parsed on background threads, so it may be called from several of
+    // them at once, and not only from the UI thread.
     typedef std::function<void (Severity severity, ErrorCode code, std::string info)> LogCallback;
 
     void setLogger (LogCallback logger);
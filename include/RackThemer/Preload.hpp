@@ -0,0 +1,79 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Common.hpp"
+
+#include <rack.hpp>
+
+#include <string>
+#include <vector>
+
+namespace rack_themer {
+    /** A list of assets to load ahead of time. */
+    struct PreloadManifest {
+        std::vector<std::string> themePaths;
+        std::vector<std::string> svgPaths;
+
+        /** Adds every SVG file in the directory. Subdirectories are included if recursive. */
+        void addSvgDirectory (const std::string& directory, bool recursive = true);
+    };
+
+    struct PreloadTiming {
+        std::string path;
+        bool isTheme = false;
+        bool loaded = false;
+        /** Time spent loading the file and compiling it for every loaded theme, in milliseconds. */
+        double milliseconds = 0.0;
+    };
+
+    struct PreloadResult {
+        std::vector<PreloadTiming> timings;
+        int numLoaded = 0;
+        int numFailed = 0;
+        /** Wall time of the whole preload, in milliseconds. */
+        double milliseconds = 0.0;
+    };
+
+    /**
+     * Loads every asset of the manifest into the cache, in parallel on background threads, and waits for them all.
+     * Themes are loaded first, so each SVG can then be compiled for all of them. Assets that were already loaded are
+     * only compiled for any theme they're missing.
+     */
+    PreloadResult preloadAssets (const PreloadManifest& manifest);
+
+    /**
+     * Stops the background threads that load assets. Call it from your plugin's destroy () function, so they're
+     * joined before the plugin is unloaded. Otherwise they're joined by a static destructor during unloading, which
+     * can deadlock on Windows. Assets requested afterwards are loaded on the calling thread.
+     * Loads that hadn't started yet are dropped. Widgets treat them as failed, and their futures throw std::future_error.
+     */
+    void shutdown ();
+
+    /**
+     * The parse cache keeps the parsed form of every SVG and theme in Rack's user folder, so later launches can load
+     * them without parsing. Entries are matched to their files by content, so edited files are parsed again.
+     * It's enabled by default.
+     */
+    void setParseCacheEnabled (bool enabled);
+    bool isParseCacheEnabled ();
+    /** Deletes every entry of the parse cache. */
+    void clearParseCache ();
+}
\ No newline at end of file
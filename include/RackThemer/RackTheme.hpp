@@ -24,6 +24,7 @@
 
 #include <rack.hpp>
 
+#include <future>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -154,21 +155,38 @@ namespace rack_themer {
         Style combineStyle (const Style& otherStyle) const;
     };
 
+    struct ThemeBinary;
     struct ThemeLoader;
     struct RackTheme {
+        friend ThemeBinary;
         friend ThemeLoader;
 
       private:
+        // Identifies the theme's draw programs in the cache, where its address could be reused by a later theme.
+        UniqueId uniqueId;
         std::string name;
         std::unordered_map<KeyedString, std::shared_ptr<Style>> classStyles;
         std::unordered_map<KeyedString, std::shared_ptr<Style>> idStyles;
 
       public:
         std::string getName () const { return name; }
+        /** Returns a number no other theme ever gets, even one allocated at this one's address after it's freed. */
+        uint64_t getUniqueId () const { return uniqueId.value; }
         std::shared_ptr<Style> getIdStyle (const KeyedString& name) const;
         std::shared_ptr<Style> getClassStyle (const KeyedString& name) const;
     };
 
     std::shared_ptr<RackTheme> getNullTheme ();
     std::shared_ptr<RackTheme> loadRackTheme (const std::string& path);
+    /** Loads the theme on a background thread. The future holds null if loading failed. */
+    std::shared_future<std::shared_ptr<RackTheme>> loadRackThemeAsync (const std::string& path);
+
+    /** Returns where loadRackTheme looks for the compiled binary of a theme: the same path, with the extension ".themeb". */
+    std::string getCompiledThemePath (const std::string& themePath);
+    /**
+     * Compiles the theme into a binary that holds its parsed styles, and writes it to getCompiledThemePath.
+     * While the binary matches the theme's current size and hash, or the theme is missing, loadRackTheme reads it
+     * instead of parsing the JSON. Binaries of an older format are ignored.
+     */
+    bool compileRackTheme (const std::string& themePath);
 }
\ No newline at end of file
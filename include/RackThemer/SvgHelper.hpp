@@ -29,6 +29,7 @@
 
 #include <optional>
 #include <regex>
+#include <string_view>
 #include <type_traits>
 
 namespace rack_themer {
@@ -96,7 +97,7 @@ namespace rack_themer {
         void forEachPrefixed (const std::string& prefix, const std::function<void (unsigned int i, NSVGshape*)>& callback) {
             unsigned int i = 0;
             forEachShape ([&] (NSVGshape* shape) {
-                if (getShapeId (shape).find (prefix) == 0)
+                if (getShapeId (shape).substr (0, prefix.size ()) == prefix)
                     callback (i++, shape);
             });
         }
@@ -121,9 +122,9 @@ namespace rack_themer {
             forEachShape ([&] (NSVGshape* shape) {
                 auto id = getShapeId (shape);
                 std::vector<std::string> captures;
-                std::smatch match;
+                std::match_results<std::string_view::const_iterator> match;
 
-                if (std::regex_search (id, match, regex)) {
+                if (std::regex_search (id.begin (), id.end (), match, regex)) {
                     for (unsigned int i = 1; i < match.size (); i++)
                         captures.push_back (match [i]);
 
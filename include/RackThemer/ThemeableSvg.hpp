@@ -20,37 +20,221 @@
 #pragma once
 
 #include "Common.hpp"
+#include "DrawStats.hpp"
 #include "KeyedString.hpp"
 #include "RackTheme.hpp"
 
 #include <rack.hpp>
 
+#include <atomic>
+#include <future>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace rack_themer {
+    struct DrawProgram;
+    struct SvgBenchmarks;
+    struct SvgBinary;
+    struct SvgTests;
     struct ThemeCache;
 
-    struct ThemeableSvg {
+    struct SvgGradient {
+        bool radial = false;
+
+        // Linear gradients run from start to end. Radial gradients are centered on start, and end at radius.
+        rack::math::Vec start;
+        rack::math::Vec end;
+        float radius = 0.f;
+    };
+
+    struct SvgPaint {
+        // One of NSVGpaintType.
+        int type = NSVG_PAINT_NONE;
+        unsigned int color = 0;
+
+        // For gradients, the colors of the first and last stops.
+        int numStops = 0;
+        unsigned int firstStopColor = 0;
+        unsigned int lastStopColor = 0;
+    };
+
+    struct SvgShape {
+        NSVGshape* source = nullptr;
+
+        // The shape's id is split into these at load time: "shapeId--styleClass".
+        KeyedString shapeId;
+        KeyedString styleClass;
+
+        bool visible = true;
+        bool evenOdd = false;
+
+        // Indices into ThemeableSvg::gradients, or -1 if the paint isn't a gradient.
+        int fillGradient = -1;
+        int strokeGradient = -1;
+
+        // Range of this shape's paths in ThemeableSvg::paths.
+        int firstPath = 0;
+        int numPaths = 0;
+
+        float bounds [4] = { };
+
+        // The shape's own style, as written in the SVG.
+        SvgPaint fill;
+        SvgPaint stroke;
+        float opacity = 1.f;
+        float strokeWidth = 1.f;
+        int strokeLineCap = NVG_BUTT;
+        int strokeLineJoin = NVG_MITER;
+    };
+
+    struct SvgPath {
+        // Range of this path's points in ThemeableSvg::points, in points rather than floats.
+        int firstPoint = 0;
+        int numPoints = 0;
+        // Index of this path's first curve in ThemeableSvg::segmentLodTiers.
+        int firstSegment = 0;
+
+        bool closed = false;
+        NVGsolidity winding = NVG_SOLID;
+
+        float bounds [4] = { };
+    };
+
+    /** Measurements of an SVG's contents, computed when it's loaded. */
+    struct SvgMetrics {
+        /** The thinnest visible shape or stroke, in SVG units. Infinite if there are none. */
+        float minFeatureSize = INFINITY;
+        /** The thinnest stroke width set by the SVG itself. Themes may override it. Infinite if nothing is stroked. */
+        float minStrokeWidth = INFINITY;
+        int numPoints = 0;
+    };
+
+    /**
+     * An SVG flattened into tables that can be drawn with any theme.
+     * SVGs loaded from a compiled binary or the parse cache aren't backed by a NanoSVG image. The shapes forEachShape
+     * and SvgHelper pass on are stand-ins then, which only hold each shape's id, flags, fill rule and bounds, and have
+     * no paths, paints or transform.
+     */
+    struct ThemeableSvg : std::enable_shared_from_this<ThemeableSvg> {
+        friend DrawProgram;
+        friend SvgBenchmarks;
+        friend SvgBinary;
+        friend SvgTests;
         friend ThemeCache;
 
       private:
+        // Null for SVGs loaded from a compiled binary or the parse cache. Their shapes' sources are stand-ins instead,
+        // which only hold the id, flags, fill rule and bounds of the original shapes, and have no paths.
         NSVGimage* handle = nullptr;
+        std::vector<NSVGshape> shapeStandIns;
+        // Identifies the SVG's draw programs in the cache, where its address could be reused by a later SVG.
+        UniqueId uniqueId;
+        // The canonical path of the file it was first loaded from. Identical files loaded later share this SVG.
+        std::string path;
+        // The size of the contents whose hash it's cached under, to tell them apart from others with the same hash.
+        size_t sourceSize = 0;
+
+        // The geometry of the image, flattened into contiguous tables when it's loaded.
+        // Paths without any points are left out, so numPaths counts the paths of the original image.
+        std::vector<SvgShape> shapes;
+        std::vector<SvgPath> paths;
+        std::vector<float> points;
+        std::vector<SvgGradient> gradients;
+        // The level of detail tier at which each curve becomes flat enough to be drawn as a line.
+        std::vector<uint8_t> segmentLodTiers;
+
+        rack::math::Vec size;
+        int numPaths = 0;
+        int numPoints = 0;
+        SvgMetrics metrics;
+
+        // Estimated memory held by the image and its tables, in bytes.
+        size_t memoryUsage = 0;
+        // When the SVG was last requested from the cache, used to evict the least recently used ones first.
+        std::atomic<uint64_t> lastAccess = 0;
+
+        mutable uint64_t numCulledShapes = 0;
+        // Totals over every theme. The per theme statistics are kept by each theme's draw program.
+        mutable DrawStats stats;
+
+        void buildGeometry ();
+        NVGsolidity getEvenOddWinding (const SvgShape& shape, int pathIndex) const;
+        NVGsolidity getNonZeroWinding (int pathIndex) const;
 
       public:
+        ThemeableSvg () { }
+        // The NanoSVG image is owned by this object, so it can't be copied.
+        ThemeableSvg (const ThemeableSvg&) = delete;
+        ThemeableSvg& operator= (const ThemeableSvg&) = delete;
+        ~ThemeableSvg ();
+
         rack::math::Vec getSize ();
         int getNumShapes ();
         int getNumPaths ();
         int getNumPoints ();
+        SvgMetrics getMetrics ();
+        /** Returns a number no other SVG ever gets, even one allocated at this one's address after it's freed. */
+        uint64_t getUniqueId () const { return uniqueId.value; }
+        /** Returns roughly how much memory the SVG uses, in bytes. Doesn't include its compiled draw programs. */
+        size_t getMemoryUsage () const { return memoryUsage; }
+        /** Returns how many shapes have been skipped so far for falling outside the clip box they were drawn with. */
+        uint64_t getNumCulledShapes () const { return numCulledShapes; }
+        /** Returns the SVG's draw statistics, over every theme it has been drawn with. See DrawStats. */
+        DrawStats getStats () const { return stats; }
+        void resetStats () { stats = DrawStats (); }
+
         void draw (NVGcontext* vg, std::shared_ptr<RackTheme> theme);
+        /**
+         * Draws the SVG, skipping any shapes that fall entirely outside of clipBox.
+         * With levelOfDetail, shapes too small to see at the current scale are skipped and small curves are drawn as lines.
+         */
+        void draw (NVGcontext* vg, std::shared_ptr<RackTheme> theme, rack::math::Rect clipBox, bool levelOfDetail = false);
 
         /*
          * FOR INTERNAL USE ONLY! DO NOT USE!
+         * The shapes are stand-ins without paths for SVGs that weren't parsed from their text, see above.
          */
         void forEachShape (const std::function<void (NSVGshape*)>& callback);
     };
 
-    std::string getShapeId (const NSVGshape* shape);
+    using SvgFuture = std::shared_future<std::shared_ptr<ThemeableSvg>>;
+
+    /** Counts of how SVG requests have been served. */
+    struct SvgCacheStats {
+        /** Requests for a path that had already been loaded. */
+        uint64_t numPathHits = 0;
+        /** Files that were read, but were identical to an SVG already loaded from another path. */
+        uint64_t numDeduplicated = 0;
+        uint64_t numParsed = 0;
+    };
+
+    /** Returns the part of the shape's id before its style class. The view points into the shape's own id. */
+    std::string_view getShapeId (const NSVGshape* shape);
     std::shared_ptr<ThemeableSvg> loadSvg (const std::string& path);
+    /** Loads the SVG on a background thread. The future holds null if loading failed. */
+    SvgFuture loadSvgAsync (const std::string& path);
+
+    /** Returns where loadSvg looks for the compiled binary of an SVG: the same path, with the extension ".svgb". */
+    std::string getCompiledSvgPath (const std::string& svgPath);
+    /**
+     * Compiles the SVG into a binary that holds its flattened geometry, and writes it to getCompiledSvgPath.
+     * While the binary matches the SVG's current size and hash, or the SVG is missing, loadSvg reads it instead of
+     * parsing the SVG. Binaries of an older format are ignored.
+     */
+    bool compileSvg (const std::string& svgPath);
+
+    /**
+     * Sets how much memory loaded SVGs and their draw programs may use before the ones no widget holds anymore get
+     * evicted, least recently requested first. SVGs in use are never evicted. Zero, the default, means no limit.
+     */
+    void setSvgMemoryBudget (size_t bytes);
+    size_t getSvgMemoryBudget ();
+    /** Returns roughly how much memory every loaded SVG and its draw programs use, in bytes. */
+    size_t getSvgMemoryUsage ();
+    SvgCacheStats getSvgCacheStats ();
+    /** Evicts every SVG and theme that nothing outside the cache holds anymore. */
+    void purgeUnusedAssets ();
 }
\ No newline at end of file
@@ -26,7 +26,13 @@
 #include <memory>
 
 namespace rack_themer {
+    struct DrawProgram;
+
     struct ThemedSvg {
+      private:
+        // Compiled for the current svg and theme on the next draw.
+        std::shared_ptr<DrawProgram> program = nullptr;
+
       public:
         std::shared_ptr<ThemeableSvg> svg = nullptr;
         std::shared_ptr<RackTheme> theme = nullptr;
@@ -49,11 +55,10 @@ namespace rack_themer {
         int getNumPaths () { return svg != nullptr ? svg->getNumPaths () : 0; }
         int getNumPoints () { return svg != nullptr ? svg->getNumPoints () : 0; }
 
-        void draw (NVGcontext* vg) {
-            if (svg == nullptr || theme == nullptr)
-                return;
+        /** Returns the draw statistics of the SVG with this theme specifically. See DrawStats. */
+        DrawStats getStats () const;
 
-            svg->draw (vg, theme);
-        }
+        void draw (NVGcontext* vg) { draw (vg, rack::math::Rect::inf ()); }
+        void draw (NVGcontext* vg, rack::math::Rect clipBox, bool levelOfDetail = false);
     };
 }
\ No newline at end of file
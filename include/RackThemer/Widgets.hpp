@@ -25,13 +25,29 @@
 
 #include <rack.hpp>
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace rack_themer {
+    struct SharedFramebuffer;
+    struct SharedFramebufferKey;
+
 namespace widgets {
     struct SvgWidget : rack::widget::Widget, IThemedWidget {
         ThemedSvg svg;
         bool autoSwitchTheme = true;
+        /**
+         * Skip shapes outside the clip box when drawing. Only enable it if nothing between the widget and the framebuffer
+         * or window it's drawn into applies a transform the clip box doesn't follow, like a TransformWidget's rotation.
+         * The library's own widgets enable it wherever that holds.
+         */
+        bool clipCulling = false;
+        /**
+         * Skip shapes too small to see and draw small curves as lines when zoomed out. Thin details may disappear
+         * sooner than they would otherwise. The library's own widgets enable it.
+         */
+        bool levelOfDetail = false;
 
         SvgWidget () : svg (nullptr, nullptr) { box.size = rack::math::Vec (); }
 
@@ -39,11 +55,56 @@ namespace widgets {
         void setSvg (std::shared_ptr<ThemeableSvg> svg) { setSvg (this->svg.withSvg (svg)); }
         void setSvg (ThemedSvg svg) {
             this->svg = svg;
+            pendingSvg = SvgFuture ();
             wrap ();
         }
-        void draw (const DrawArgs& args) override { svg.draw (args.vg); }
+        /**
+         * Shows the SVG once it has finished loading, and keeps drawing the current one until then.
+         * When it's ready, it's passed to onLoad if given. Otherwise it's set with setSvg, and the framebuffer holding
+         * this widget is dirtied.
+         */
+        void setSvgAsync (SvgFuture svg, std::function<void (std::shared_ptr<ThemeableSvg>)> onLoad = nullptr);
+        bool isLoading () const { return pendingSvg.valid (); }
+
+        void step () override;
+        void draw (const DrawArgs& args) override { svg.draw (args.vg, clipCulling ? args.clipBox : rack::math::Rect::inf (), levelOfDetail); }
 
         void onThemeChanged (std::shared_ptr<rack_themer::RackTheme> theme) override;
+
+      private:
+        SvgFuture pendingSvg;
+        std::function<void (std::shared_ptr<ThemeableSvg>)> onLoad;
+    };
+
+    /**
+     * A framebuffer whose image is shared by every widget of the same type drawing the same SVG and theme at the same
+     * size and zoom, so identical widgets only render and store it once.
+     * Sharing assumes the image is fully determined by that, so disable it if the children draw anything else that
+     * differs between instances. Dirtying it only looks the image up again, and never renders an image that was
+     * already rendered, so also disable it if the children change what they draw without changing the key widget's
+     * SVG or theme.
+     */
+    struct SharedFramebufferWidget : rack::widget::FramebufferWidget {
+        /** The widget whose SVG and theme identify the image. The image isn't shared while this is null. */
+        SvgWidget* keyWidget = nullptr;
+        bool shared = true;
+        /** Draw the image under rotated transforms by rotating it, instead of rendering the children directly. */
+        bool rotatable = false;
+        /**
+         * SVGs the key widget switches between. Their images are rendered along with the current one and kept alive,
+         * so switching between them only swaps which image is drawn.
+         */
+        std::vector<std::shared_ptr<ThemeableSvg>> frames;
+
+        void draw (const DrawArgs& args) override;
+        void onContextDestroy (const ContextDestroyEvent& e) override;
+
+      private:
+        std::shared_ptr<SharedFramebuffer> image;
+        std::vector<std::shared_ptr<SharedFramebuffer>> frameImages;
+
+        void renderShared (SharedFramebuffer& target, rack::math::Vec scale);
+        void prepareFrames (const SharedFramebufferKey& key, rack::math::Vec scale);
     };
 
     struct SvgPanel : rack::widget::Widget {
@@ -51,15 +112,35 @@ namespace widgets {
         SvgWidget* svgWidget;
         rack::app::PanelBorder* panelBorder;
 
+        /**
+         * The most the panel will be oversampled by. It's never oversampled by more than Rack's own panels are: twice
+         * below a pixel ratio of 2, and not at all above it.
+         */
+        float maxOversample = 2.f;
+        /** Always oversample the panel by this factor instead of picking one, if greater than zero. */
+        float forcedOversample = 0.f;
+        /** How many pixels wide the thinnest feature of the panel should be once oversampled. */
+        float minFeaturePixels = 2.f;
+        /** Panels with at most this many points only need their thinnest feature to be one pixel wide. */
+        int simplePanelPoints = 200;
+
         SvgPanel ();
 
+        /**
+         * Picks the oversampling factor for the panel from the background's metrics, the zoom and the window's pixel
+         * ratio. It only goes below Rack's own factor for simple panels, or ones without thin details.
+         * Override to implement a different policy.
+         */
+        virtual float getOversample (float zoom, float pixelRatio);
+
         void step () override;
         void setBackground (std::shared_ptr<ThemeableSvg> svg) { setBackground (svgWidget->svg.withSvg (svg)); }
         void setBackground (ThemedSvg svg);
+        void setBackgroundAsync (SvgFuture svg) { svgWidget->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setBackground (svg); }); }
     };
 
     struct SvgPort : rack::app::PortWidget {
-        rack::widget::FramebufferWidget* framebuffer;
+        SharedFramebufferWidget* framebuffer;
         rack::app::CircularShadow* shadow;
         SvgWidget* svgWidget;
 
@@ -67,20 +148,22 @@ namespace widgets {
 
         void setSvg (std::shared_ptr<ThemeableSvg> svg) { setSvg (svgWidget->svg.withSvg (svg)); }
         void setSvg (ThemedSvg svg);
+        void setSvgAsync (SvgFuture svg) { svgWidget->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setSvg (svg); }); }
     };
 
     struct SvgScrew : rack::widget::Widget {
-        rack::widget::FramebufferWidget* framebuffer;
+        SharedFramebufferWidget* framebuffer;
         SvgWidget* svgWidget;
 
         SvgScrew ();
 
         void setSvg (std::shared_ptr<ThemeableSvg> svg) { setSvg (svgWidget->svg.withSvg (svg)); }
         void setSvg (ThemedSvg svg);
+        void setSvgAsync (SvgFuture svg) { svgWidget->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setSvg (svg); }); }
     };
 
     struct SvgButton : rack::widget::OpaqueWidget {
-        rack::widget::FramebufferWidget* framebuffer;
+        SharedFramebufferWidget* framebuffer;
         rack::app::CircularShadow* shadow;
         SvgWidget* svgWidget;
         std::vector<std::shared_ptr<ThemeableSvg>> frames;
@@ -88,6 +171,8 @@ namespace widgets {
         SvgButton ();
 
         void addFrame (std::shared_ptr<ThemeableSvg> svg);
+        /** Shows the given frame. Does nothing if it's already shown. */
+        void setFrame (int index);
         void onButton (const ButtonEvent& e) override;
         void onDragStart (const DragStartEvent& e) override;
         void onDragEnd (const DragEndEvent& e) override;
@@ -95,7 +180,7 @@ namespace widgets {
     };
 
     struct SvgSwitch : rack::app::Switch {
-        rack::widget::FramebufferWidget* framebuffer;
+        SharedFramebufferWidget* framebuffer;
         rack::app::CircularShadow* shadow;
         SvgWidget* svgWidget;
         std::vector<std::shared_ptr<ThemeableSvg>> frames;
@@ -107,6 +192,8 @@ namespace widgets {
         ~SvgSwitch ();
         /** Adds an SVG file to represent the next switch position. */
         void addFrame (std::shared_ptr<ThemeableSvg> svg);
+        /** Shows the given frame. Does nothing if it's already shown. */
+        void setFrame (int index);
 
         void onDragStart (const DragStartEvent& e) override;
         void onDragEnd (const DragEndEvent& e) override;
@@ -118,10 +205,20 @@ namespace widgets {
         rack::app::CircularShadow* shadow;
         rack::widget::TransformWidget* transformWidget;
         SvgWidget* svgWidget;
+        /** Holds the unrotated SVG when fast rotation is enabled. */
+        SharedFramebufferWidget* rotor = nullptr;
 
         SvgKnob ();
         void setSvg (std::shared_ptr<ThemeableSvg> svg) { setSvg (svgWidget->svg.withSvg (svg)); }
         void setSvg (ThemedSvg svg);
+        void setSvgAsync (SvgFuture svg) { svgWidget->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setSvg (svg); }); }
+        /**
+         * Renders the SVG once per theme and zoom level and rotates the resulting image, instead of re-rendering the
+         * whole knob every time its value changes. The shadow stays in the regular framebuffer.
+         * Rotating the image softens its edges slightly, so it's best suited to knobs that get modulated or moved a lot.
+         */
+        void setFastRotation (bool fastRotation);
+        bool isFastRotation () const { return rotor != nullptr; }
         void onChange (const ChangeEvent& e) override;
     };
 
@@ -130,17 +227,26 @@ namespace widgets {
      * Can be used for horizontal or vertical linear faders.
      */
     struct SvgSlider : rack::app::SliderKnob {
-        rack::widget::FramebufferWidget* framebuffer;
+        /** Holds the background only. Moving the handle never re-renders it. */
+        SharedFramebufferWidget* framebuffer;
         SvgWidget* background;
+        /**
+         * Placed and moved through its box like any widget. It isn't inside framebuffer, and draws its SVG through
+         * handleFramebuffer instead, so moving it never re-renders anything.
+         */
         SvgWidget* handle;
+        /** The handle's own layer. It's a child of the handle, and holds a copy of the handle's SVG. */
+        SharedFramebufferWidget* handleFramebuffer;
         /** Intermediate positions will be interpolated between these positions. **/
         rack::math::Vec minHandlePos, maxHandlePos;
 
         SvgSlider ();
         void setBackgroundSvg (std::shared_ptr<ThemeableSvg> svg) { setBackgroundSvg (background->svg.withSvg (svg)); }
         void setBackgroundSvg (ThemedSvg svg);
+        void setBackgroundSvgAsync (SvgFuture svg) { background->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setBackgroundSvg (svg); }); }
         void setHandleSvg (std::shared_ptr<ThemeableSvg> svg) { setHandleSvg (handle->svg.withSvg (svg)); }
         void setHandleSvg (ThemedSvg svg);
+        void setHandleSvgAsync (SvgFuture svg) { handle->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setHandleSvg (svg); }); }
         void setHandlePos (rack::math::Vec minHandlePos, rack::math::Vec maxHandlePos);
         void setHandlePosCentered (rack::math::Vec minHandlePosCentered, rack::math::Vec maxHandlePosCentered);
         void onChange (const ChangeEvent& e) override;
@@ -148,18 +254,22 @@ namespace widgets {
 
     template<typename TBase = rack::app::ModuleLightWidget>
     struct TSvgLight : TBase {
-        rack::widget::FramebufferWidget* framebuffer;
+        SharedFramebufferWidget* framebuffer;
         SvgWidget* svgWidget;
 
         TSvgLight () {
-            framebuffer = new rack::widget::FramebufferWidget;
+            framebuffer = new SharedFramebufferWidget;
             this->addChild (framebuffer);
 
             svgWidget = new SvgWidget;
+            svgWidget->clipCulling = true;
+            svgWidget->levelOfDetail = true;
             framebuffer->addChild (svgWidget);
+            framebuffer->keyWidget = svgWidget;
         }
 
         void setSvg (std::shared_ptr<ThemeableSvg> svg) { setSvg (svgWidget->svg.withSvg (svg)); }
+        void setSvgAsync (SvgFuture svg) { svgWidget->setSvgAsync (svg, [this] (std::shared_ptr<ThemeableSvg> svg) { setSvg (svg); }); }
         void setSvg (ThemedSvg svg) {
             svgWidget->setSvg (svg);
             framebuffer->box.size = svgWidget->box.size;
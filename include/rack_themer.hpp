@@ -25,8 +25,10 @@
 #define RACK_THEMER_H
 
 #include "RackThemer/Common.hpp"
+#include "RackThemer/DrawStats.hpp"
 #include "RackThemer/KeyedString.hpp"
 #include "RackThemer/Logging.hpp"
+#include "RackThemer/Preload.hpp"
 #include "RackThemer/RackTheme.hpp"
 #include "RackThemer/SvgHelper.hpp"
 #include "RackThemer/ThemeableSvg.hpp"
@@ -0,0 +1,513 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *  Copyright (C) 2016-2023 VCV
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DrawProgram.hpp"
+#include "rack_themer.hpp"
+#include "ThemeCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rack_themer {
+namespace lod {
+    static float getTierMaxScale (int tier) { return tier < 1 ? INFINITY : std::ldexp (1.f, 1 - tier); }
+
+    int getTier (float scale) {
+        if (!(scale < 1.f))
+            return 0;
+
+        // 0.5 <= scale < 1 is tier 1, 0.25 <= scale < 0.5 is tier 2, and so on.
+        int exponent;
+        std::frexp (scale, &exponent);
+        return std::min (1 - exponent, MaxTier);
+    }
+
+    int getTier (NVGcontext* vg) {
+        float xform [6];
+        nvgCurrentTransform (vg, xform);
+        return getTier (std::sqrt (std::abs (xform [0] * xform [3] - xform [1] * xform [2])));
+    }
+
+    uint8_t getTierBelowSize (float size, float threshold) {
+        for (int tier = 1; tier <= MaxTier; tier++) {
+            if (size * getTierMaxScale (tier) < threshold)
+                return static_cast<uint8_t> (tier);
+        }
+
+        return NoTier;
+    }
+}
+
+    static NVGcolor getNVGColor (uint32_t color) {
+        return nvgRGBA (
+            (color >> 0) & 0xff,
+            (color >> 8) & 0xff,
+            (color >> 16) & 0xff,
+            (color >> 24) & 0xff
+        );
+    }
+
+    static bool isSameColor (const NVGcolor& lhs, const NVGcolor& rhs) {
+        return std::memcmp (lhs.rgba, rhs.rgba, sizeof (lhs.rgba)) == 0;
+    }
+
+    static NVGpaint getGradientPaint (NVGcontext* vg, const SvgGradient& gradient, NVGcolor innerCol, NVGcolor outerCol) {
+        auto s = gradient.start, e = gradient.end;
+
+        return !gradient.radial
+               ? nvgLinearGradient (vg, s.x, s.y, e.x, e.y, innerCol, outerCol)
+               : nvgRadialGradient (vg, s.x, s.y, 0.0, gradient.radius, innerCol, outerCol);
+    }
+
+    Paint getShapePaint (const SvgPaint& paint) {
+        switch (paint.type) {
+            case NSVG_PAINT_NONE:
+                return Paint::makeNone ();
+
+            case NSVG_PAINT_COLOR:
+                return Paint::makeColor (getNVGColor (paint.color));
+
+            case NSVG_PAINT_LINEAR_GRADIENT:
+            case NSVG_PAINT_RADIAL_GRADIENT: {
+                // SVG gradients without stops paint nothing.
+                if (paint.numStops < 1)
+                    return Paint::makeNone ();
+
+                // Only the first and last stops are drawn.
+                auto styleGradient = Gradient ();
+                styleGradient.nstops = std::min (paint.numStops, 2);
+                styleGradient.stops [0].color = getNVGColor (paint.firstStopColor);
+                styleGradient.stops [styleGradient.nstops - 1].color = getNVGColor (paint.lastStopColor);
+
+                return Paint::makeGradient (styleGradient);
+            }
+        }
+
+        return Paint::makeColor (rack::color::MAGENTA);
+    }
+
+    static void getStyle (Style& style, const RackTheme* themePtr, const SvgShape& shapeData) {
+        // Shape style
+        style = Style ();
+
+        // Fill
+        style.setFill (getShapePaint (shapeData.fill));
+
+        // Stroke
+        style.setStroke (getShapePaint (shapeData.stroke));
+        style.setStrokeWidth (shapeData.strokeWidth);
+        style.setStrokeLineCap (static_cast<NVGlineCap> (shapeData.strokeLineCap));
+        style.setStrokeLineJoin (shapeData.strokeLineJoin);
+
+        if (themePtr == nullptr)
+            return;
+
+        auto classStyle = themePtr->getClassStyle (shapeData.styleClass);
+        auto idStyle = themePtr->getIdStyle (shapeData.shapeId);
+
+        // Combine theme styles
+        if (classStyle != nullptr)
+            style = style.combineStyle (classStyle);
+        if (idStyle != nullptr)
+            style = style.combineStyle (idStyle);
+    }
+
+    // Themes may set a gradient without any stops. It draws nothing, same as in an SVG.
+    static bool isDrawn (const Paint& paint) {
+        return !paint.isNone () && !(paint.isGradient () && paint.getGradient ()->nstops < 1);
+    }
+
+    static ProgramPaint getProgramPaint (const Paint& stylePaint, const SvgPaint& shapePaint, int gradient) {
+        auto ret = ProgramPaint ();
+
+        auto hasGradient =
+            shapePaint.type == NSVG_PAINT_LINEAR_GRADIENT ||
+            shapePaint.type == NSVG_PAINT_RADIAL_GRADIENT;
+        if (stylePaint.isGradient () && !hasGradient) {
+            ret.kind = ProgramPaintKind::Color;
+            ret.color = getNVGColor (shapePaint.color);
+        } else if (stylePaint.isColor ()) {
+            ret.kind = ProgramPaintKind::Color;
+            ret.color = stylePaint.getColor ();
+        } else if (stylePaint.isGradient () && gradient >= 0 && stylePaint.getGradient ()->nstops >= 1) {
+            auto styleGradient = stylePaint.getGradient ();
+            ret.kind = ProgramPaintKind::Gradient;
+            ret.gradient = gradient;
+            ret.innerColor = styleGradient->stops [0].color;
+            ret.outerColor = styleGradient->stops [styleGradient->nstops - 1].color;
+        }
+
+        return ret;
+    }
+
+    bool ProgramPaint::operator== (const ProgramPaint& rhs) const {
+        if (kind != rhs.kind)
+            return false;
+
+        switch (kind) {
+            default:
+            case ProgramPaintKind::Keep:
+                return true;
+
+            case ProgramPaintKind::Color:
+                return isSameColor (color, rhs.color);
+
+            case ProgramPaintKind::Gradient:
+                return gradient == rhs.gradient &&
+                       isSameColor (innerColor, rhs.innerColor) &&
+                       isSameColor (outerColor, rhs.outerColor);
+        }
+    }
+
+    ResolvedStyles DrawProgram::resolveStyles (const ThemeableSvg& svg, const RackTheme* theme) {
+        auto styles = ResolvedStyles ();
+
+        styles.reserve (svg.shapes.size ());
+        for (const auto& shape : svg.shapes)
+            getStyle (styles.emplace_back (), theme, shape);
+
+        return styles;
+    }
+
+    bool DrawCommand::hasSameStyle (const DrawCommand& rhs) const {
+        if (opacity != rhs.opacity || fill != rhs.fill || stroke != rhs.stroke)
+            return false;
+
+        if (fill && fillPaint != rhs.fillPaint)
+            return false;
+
+        if (stroke) {
+            if (strokePaint != rhs.strokePaint ||
+                strokeWidth != rhs.strokeWidth ||
+                strokeLineCap != rhs.strokeLineCap ||
+                strokeLineJoin != rhs.strokeLineJoin)
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool isOverlapping (const float lhs [4], const float rhs [4]) {
+        return lhs [0] <= rhs [2] && rhs [0] <= lhs [2] &&
+               lhs [1] <= rhs [3] && rhs [1] <= lhs [3];
+    }
+
+    static void addBounds (float bounds [4], const float other [4]) {
+        bounds [0] = std::min (bounds [0], other [0]);
+        bounds [1] = std::min (bounds [1], other [1]);
+        bounds [2] = std::max (bounds [2], other [2]);
+        bounds [3] = std::max (bounds [3], other [3]);
+    }
+
+    // How many batches back a shape may look for one with the same style.
+    static constexpr int MaxBatchLookback = 64;
+    // NanoVG's default miter limit. Neither Rack nor the replay changes it.
+    static constexpr float MiterLimit = 10.f;
+
+    // How far a command's stroke can reach past its paths' bounds, caps and joins included.
+    static float getStrokeExtent (const DrawCommand& command) {
+        if (!command.stroke)
+            return 0.f;
+
+        // NanoVG draws a miter for any join that isn't round or bevel, up to the miter limit times half the width.
+        auto miter = command.strokeLineJoin != NVG_ROUND && command.strokeLineJoin != NVG_BEVEL;
+        return miter ? std::max (command.strokeWidth, MiterLimit * command.strokeWidth / 2.f) : command.strokeWidth;
+    }
+
+    std::shared_ptr<DrawProgram> DrawProgram::compile (const ThemeableSvg& svg, const RackTheme* theme, const ResolvedStyles& styles) {
+        auto program = std::make_shared<DrawProgram> ();
+        program->svg = &svg;
+        program->svgId = svg.getUniqueId ();
+        program->themeId = theme != nullptr ? theme->getUniqueId () : 0;
+
+        // The shapes of each batch, flattened into the program's shape table at the end.
+        std::vector<std::vector<DrawShape>> batchShapes;
+
+        for (int shapeIndex = 0; shapeIndex < static_cast<int> (svg.shapes.size ()); shapeIndex++) {
+            const auto& shapeData = svg.shapes [shapeIndex];
+
+            // Skip shapes with no paths
+            if (shapeData.numPaths == 0)
+                continue;
+
+            // Visibility
+            if (!shapeData.visible)
+                continue;
+
+            const auto& shapeStyle = styles [shapeIndex];
+
+            auto command = DrawCommand ();
+            command.numShapes = 1;
+            command.opacity = shapeData.opacity * shapeStyle.getOpacity ();
+
+            // Fill
+            if (isDrawn (shapeStyle.getFill ())) {
+                command.fill = true;
+                command.fillPaint = getProgramPaint (shapeStyle.getFill (), shapeData.fill, shapeData.fillGradient);
+            }
+
+            // Stroke
+            if (isDrawn (shapeStyle.getStroke ())) {
+                command.stroke = true;
+                command.strokePaint = getProgramPaint (shapeStyle.getStroke (), shapeData.stroke, shapeData.strokeGradient);
+                command.strokeWidth = shapeStyle.getStrokeWidth ();
+                // strokeDashOffset, strokeDashArray, strokeDashCount not yet supported
+                command.strokeLineCap = shapeStyle.getStrokeLineCap ();
+                command.strokeLineJoin = shapeStyle.getStrokeLineJoin ();
+            }
+
+            if (!command.fill && !command.stroke)
+                continue;
+
+            auto drawShape = DrawShape ();
+            drawShape.shapeIndex = shapeIndex;
+
+            auto margin = 1.f + getStrokeExtent (command);
+
+            drawShape.cullBounds [0] = shapeData.bounds [0] - margin;
+            drawShape.cullBounds [1] = shapeData.bounds [1] - margin;
+            drawShape.cullBounds [2] = shapeData.bounds [2] + margin;
+            drawShape.cullBounds [3] = shapeData.bounds [3] + margin;
+
+            auto strokeSize = command.stroke ? command.strokeWidth : 0.f;
+            auto shapeSize = std::max (shapeData.bounds [2] - shapeData.bounds [0], shapeData.bounds [3] - shapeData.bounds [1]);
+            drawShape.dropTier = lod::getTierBelowSize (shapeSize + strokeSize, lod::MinShapeSize);
+
+            // Look for an earlier batch with the same style to add the shape to. The shape can only be moved back past
+            // batches it doesn't overlap, and can only join a batch if it doesn't overlap any of the batch's shapes.
+            // Otherwise, drawing it earlier or together with them could change which one ends up on top.
+            auto target = -1;
+            auto lookbackEnd = std::max (0, static_cast<int> (program->commands.size ()) - MaxBatchLookback);
+            for (auto i = static_cast<int> (program->commands.size ()) - 1; i >= lookbackEnd; i--) {
+                const auto& batch = program->commands [i];
+
+                auto overlaps = false;
+                if (isOverlapping (batch.cullBounds, drawShape.cullBounds)) {
+                    for (const auto& other : batchShapes [i]) {
+                        if (isOverlapping (other.cullBounds, drawShape.cullBounds)) {
+                            overlaps = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (!overlaps && batch.hasSameStyle (command)) {
+                    target = i;
+                    break;
+                }
+
+                if (overlaps)
+                    break;
+            }
+
+            if (target >= 0) {
+                auto& batch = program->commands [target];
+                batch.numShapes++;
+                addBounds (batch.cullBounds, drawShape.cullBounds);
+                batch.dropTier = std::max (batch.dropTier, drawShape.dropTier);
+                batchShapes [target].push_back (drawShape);
+            } else {
+                std::copy (drawShape.cullBounds, drawShape.cullBounds + 4, command.cullBounds);
+                command.dropTier = drawShape.dropTier;
+                program->commands.push_back (command);
+                batchShapes.push_back ({ drawShape });
+            }
+        }
+
+        for (size_t i = 0; i < program->commands.size (); i++) {
+            program->commands [i].firstShape = static_cast<int> (program->shapes.size ());
+            program->shapes.insert (program->shapes.end (), batchShapes [i].begin (), batchShapes [i].end ());
+        }
+
+        return program;
+    }
+
+    /*
+     * The NanoVG state the replay has set so far. Anything not yet set is left as the caller had it.
+     */
+    struct ReplayState {
+        const ProgramPaint* fillPaint = nullptr;
+        const ProgramPaint* strokePaint = nullptr;
+
+        bool hasStrokeParams = false;
+        float strokeWidth = 1.f;
+        int strokeLineCap = NVG_BUTT;
+        int strokeLineJoin = 0;
+    };
+
+    static void applyPaint (NVGcontext* vg, const std::vector<SvgGradient>& gradients, const ProgramPaint& paint, const ProgramPaint*& current, bool isFill, DrawStats& stats) {
+        if (paint.kind == ProgramPaintKind::Keep)
+            return;
+        if (current != nullptr && *current == paint)
+            return;
+
+        if (paint.kind == ProgramPaintKind::Color) {
+            if (isFill)
+                nvgFillColor (vg, paint.color);
+            else
+                nvgStrokeColor (vg, paint.color);
+        } else {
+            if (!paint.hasGradientPaint) {
+                paint.gradientPaint = getGradientPaint (vg, gradients [paint.gradient], paint.innerColor, paint.outerColor);
+                paint.hasGradientPaint = true;
+                RACK_THEMER_STAT (stats.numGradientPaints++);
+            }
+
+            if (isFill)
+                nvgFillPaint (vg, paint.gradientPaint);
+            else
+                nvgStrokePaint (vg, paint.gradientPaint);
+        }
+
+        current = &paint;
+    }
+
+    static bool isOutside (const float bounds [4], const rack::math::Rect& clipBox) {
+        return bounds [2] < clipBox.getLeft () ||
+               bounds [0] > clipBox.getRight () ||
+               bounds [3] < clipBox.getTop () ||
+               bounds [1] > clipBox.getBottom ();
+    }
+
+    void DrawProgram::replay (NVGcontext* vg, rack::math::Rect clipBox, bool levelOfDetail) const {
+        if (vg == nullptr || svg == nullptr || commands.empty ())
+            return;
+
+        auto frameStats = DrawStats ();
+#ifdef RACK_THEMER_STATS
+        auto startTime = rack::system::getNanoseconds ();
+        frameStats.numDraws = 1;
+#endif
+
+        auto cull = clipBox.isFinite ();
+        auto lodTier = levelOfDetail ? lod::getTier (vg) : 0;
+
+        nvgSave (vg);
+
+        auto state = ReplayState ();
+        for (const auto& command : commands) {
+            if (cull && isOutside (command.cullBounds, clipBox)) {
+                svg->numCulledShapes += command.numShapes;
+                RACK_THEMER_STAT (frameStats.numShapesCulled += command.numShapes);
+                continue;
+            }
+
+            if (lodTier >= command.dropTier) {
+                RACK_THEMER_STAT (frameStats.numShapesSkipped += command.numShapes);
+                continue;
+            }
+
+            // Opacity
+            // Partially transparent batches get their own state scope, so the alpha doesn't leak into the next ones.
+            auto savedState = state;
+            auto hasAlpha = command.opacity < 1.0;
+            if (hasAlpha) {
+                nvgSave (vg);
+                nvgAlpha (vg, command.opacity);
+            }
+
+            // Build path
+            nvgBeginPath (vg);
+
+            auto numDrawn = 0;
+            auto drawShapesEnd = shapes.data () + command.firstShape + command.numShapes;
+            for (auto drawShape = shapes.data () + command.firstShape; drawShape != drawShapesEnd; drawShape++) {
+                if (command.numShapes > 1) {
+                    if (cull && isOutside (drawShape->cullBounds, clipBox)) {
+                        svg->numCulledShapes++;
+                        RACK_THEMER_STAT (frameStats.numShapesCulled++);
+                        continue;
+                    }
+
+                    if (lodTier >= drawShape->dropTier) {
+                        RACK_THEMER_STAT (frameStats.numShapesSkipped++);
+                        continue;
+                    }
+                }
+
+                const auto& shape = svg->shapes [drawShape->shapeIndex];
+                auto pathsEnd = svg->paths.data () + shape.firstPath + shape.numPaths;
+                for (auto path = svg->paths.data () + shape.firstPath; path != pathsEnd; path++) {
+                    auto pts = svg->points.data () + 2 * path->firstPoint;
+                    auto segmentTier = svg->segmentLodTiers.data () + path->firstSegment;
+
+                    nvgMoveTo (vg, pts [0], pts [1]);
+                    for (auto i = 1; i < path->numPoints; i += 3, segmentTier++) {
+                        auto p = &pts [2 * i];
+                        if (lodTier >= *segmentTier) {
+                            nvgLineTo (vg, p [4], p [5]);
+                        } else {
+                            nvgBezierTo (vg, p [0], p [1], p [2], p [3], p [4], p [5]);
+                            RACK_THEMER_STAT (frameStats.numBeziers++);
+                        }
+                    }
+
+                    // Close path
+                    if (path->closed)
+                        nvgClosePath (vg);
+
+                    nvgPathWinding (vg, path->winding);
+                }
+
+                RACK_THEMER_STAT (frameStats.numPaths += shape.numPaths);
+                numDrawn++;
+            }
+
+            RACK_THEMER_STAT (frameStats.numShapesDrawn += numDrawn);
+
+            // Fill shape
+            if (numDrawn > 0 && command.fill) {
+                applyPaint (vg, svg->gradients, command.fillPaint, state.fillPaint, true, frameStats);
+                nvgFill (vg);
+            }
+
+            // Stroke shape
+            if (numDrawn > 0 && command.stroke) {
+                if (!state.hasStrokeParams || state.strokeWidth != command.strokeWidth)
+                    nvgStrokeWidth (vg, command.strokeWidth);
+                if (!state.hasStrokeParams || state.strokeLineCap != command.strokeLineCap)
+                    nvgLineCap (vg, command.strokeLineCap);
+                if (!state.hasStrokeParams || state.strokeLineJoin != command.strokeLineJoin)
+                    nvgLineJoin (vg, command.strokeLineJoin);
+
+                state.hasStrokeParams = true;
+                state.strokeWidth = command.strokeWidth;
+                state.strokeLineCap = command.strokeLineCap;
+                state.strokeLineJoin = command.strokeLineJoin;
+
+                applyPaint (vg, svg->gradients, command.strokePaint, state.strokePaint, false, frameStats);
+                nvgStroke (vg);
+            }
+
+            if (hasAlpha) {
+                nvgRestore (vg);
+                state = savedState;
+            }
+        }
+
+        nvgRestore (vg);
+
+#ifdef RACK_THEMER_STATS
+        frameStats.drawTime = rack::system::getNanoseconds () - startTime;
+        stats += frameStats;
+        svg->stats += frameStats;
+#endif
+    }
+}
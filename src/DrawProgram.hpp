@@ -0,0 +1,153 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <nanosvg.h>
+#include <rack.hpp>
+
+#include <memory>
+#include <vector>
+
+// Counter updates compile to nothing unless the library is built with draw statistics.
+#ifdef RACK_THEMER_STATS
+#define RACK_THEMER_STAT(expr) (expr)
+#else
+#define RACK_THEMER_STAT(expr) ((void) 0)
+#endif
+
+namespace rack_themer {
+namespace lod {
+    /*
+     * Level of detail tiers. Tier 0 is used at a scale of 1 or more and always draws at full detail.
+     * Every tier after that covers half the scale of the one before it.
+     */
+    constexpr int MaxTier = 8;
+    constexpr uint8_t NoTier = 0xFF;
+
+    // Curves that deviate less than this from a straight line on screen are drawn as one.
+    constexpr float CurveTolerance = .25f;
+    // Shapes smaller than this on screen aren't drawn at all.
+    constexpr float MinShapeSize = .5f;
+
+    int getTier (float scale);
+    int getTier (NVGcontext* vg);
+    // Returns the first tier at which something of the given size becomes smaller than threshold on screen.
+    uint8_t getTierBelowSize (float size, float threshold);
+}
+
+    enum class ProgramPaintKind {
+        Keep,
+        Color,
+        Gradient,
+    };
+
+    struct ProgramPaint {
+        ProgramPaintKind kind = ProgramPaintKind::Keep;
+        NVGcolor color = NVGcolor ();
+
+        // Gradients take their geometry from the SVG, and their colors from the resolved style.
+        int gradient = -1;
+        NVGcolor innerColor = NVGcolor ();
+        NVGcolor outerColor = NVGcolor ();
+
+        // The gradient's NanoVG paint, built the first time it's drawn.
+        mutable bool hasGradientPaint = false;
+        mutable NVGpaint gradientPaint = NVGpaint ();
+
+        bool operator== (const ProgramPaint& rhs) const;
+        bool operator!= (const ProgramPaint& rhs) const { return !(*this == rhs); }
+    };
+
+    // The fully resolved style of every shape in a ThemeableSvg, indexed by shape ordinal.
+    using ResolvedStyles = std::vector<Style>;
+
+    struct DrawShape {
+        int shapeIndex = 0;
+
+        // The shape's bounds, grown to cover its stroke and antialiasing.
+        float cullBounds [4] = { };
+        // The level of detail tier at which the shape becomes too small to draw.
+        uint8_t dropTier = lod::NoTier;
+    };
+
+    struct DrawCommand {
+        // Range of this command's shapes in DrawProgram::shapes. They all share the same style and none of their
+        // bounds overlap, so they're built into a single path and filled and stroked together.
+        int firstShape = 0;
+        int numShapes = 0;
+
+        // The union of the shapes' bounds, and the tier at which all of them are too small to draw.
+        float cullBounds [4] = { };
+        uint8_t dropTier = lod::NoTier;
+
+        float opacity = 1.f;
+
+        bool fill = false;
+        ProgramPaint fillPaint;
+
+        bool stroke = false;
+        ProgramPaint strokePaint;
+        float strokeWidth = 1.f;
+        int strokeLineCap = NVG_BUTT;
+        int strokeLineJoin = 0;
+
+        bool hasSameStyle (const DrawCommand& rhs) const;
+    };
+
+    /*
+     * A flat list of draw commands compiled from a ThemeableSvg and a RackTheme, with every style already resolved.
+     * Shapes with identical styles are batched into one command wherever their bounds prove it can't change the
+     * result. Replaying it only emits the NanoVG state changes that differ from the previous command.
+     */
+    struct DrawProgram {
+        friend SvgTests;
+
+      private:
+        const ThemeableSvg* svg = nullptr;
+        // The unique ids of the SVG and theme it was compiled for. The theme's id is zero for the null theme.
+        uint64_t svgId = 0;
+        uint64_t themeId = 0;
+        std::vector<DrawCommand> commands;
+        std::vector<DrawShape> shapes;
+
+        mutable DrawStats stats;
+
+      public:
+        static ResolvedStyles resolveStyles (const ThemeableSvg& svg, const RackTheme* theme);
+        static std::shared_ptr<DrawProgram> compile (const ThemeableSvg& svg, const RackTheme* theme, const ResolvedStyles& styles);
+
+        bool isCompiledFor (const ThemeableSvg& svg, const RackTheme* theme) const {
+            return svgId == svg.getUniqueId () && themeId == (theme != nullptr ? theme->getUniqueId () : 0);
+        }
+        int getNumCommands () const { return static_cast<int> (commands.size ()); }
+        int getNumShapes () const { return static_cast<int> (shapes.size ()); }
+        size_t getMemoryUsage () const { return sizeof (DrawProgram) + commands.capacity () * sizeof (DrawCommand) + shapes.capacity () * sizeof (DrawShape); }
+        DrawStats getStats () const { return stats; }
+        void resetStats () { stats = DrawStats (); }
+
+        /*
+         * Draws every command whose bounds overlap clipBox. Nothing is culled if clipBox isn't finite.
+         * With levelOfDetail, tiny shapes are dropped and small curves are drawn as lines, depending on the current
+         * transform's scale.
+         */
+        void replay (NVGcontext* vg, rack::math::Rect clipBox = rack::math::Rect::inf (), bool levelOfDetail = false) const;
+    };
+}
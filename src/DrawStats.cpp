@@ -0,0 +1,61 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "rack_themer.hpp"
+#include "ThemeCache.hpp"
+
+namespace rack_themer {
+    DrawStats& DrawStats::operator+= (const DrawStats& rhs) {
+        numDraws += rhs.numDraws;
+        numShapesDrawn += rhs.numShapesDrawn;
+        numShapesCulled += rhs.numShapesCulled;
+        numShapesSkipped += rhs.numShapesSkipped;
+        numPaths += rhs.numPaths;
+        numBeziers += rhs.numBeziers;
+        numGradientPaints += rhs.numGradientPaints;
+        numCrossingTests += rhs.numCrossingTests;
+        drawTime += rhs.drawTime;
+        return *this;
+    }
+
+    json_t* DrawStats::toJson () const {
+        auto rootJ = json_object ();
+        json_object_set_new (rootJ, "draws", json_integer (numDraws));
+        json_object_set_new (rootJ, "shapesDrawn", json_integer (numShapesDrawn));
+        json_object_set_new (rootJ, "shapesCulled", json_integer (numShapesCulled));
+        json_object_set_new (rootJ, "shapesSkipped", json_integer (numShapesSkipped));
+        json_object_set_new (rootJ, "paths", json_integer (numPaths));
+        json_object_set_new (rootJ, "beziers", json_integer (numBeziers));
+        json_object_set_new (rootJ, "gradientPaints", json_integer (numGradientPaints));
+        json_object_set_new (rootJ, "crossingTests", json_integer (numCrossingTests));
+        json_object_set_new (rootJ, "drawTimeNs", json_integer (drawTime));
+        return rootJ;
+    }
+
+    bool isDrawStatsEnabled () {
+#ifdef RACK_THEMER_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    json_t* getDrawStatsJson () { return themeCache.getDrawStatsJson (); }
+    void resetDrawStats () { themeCache.resetDrawStats (); }
+}
\ No newline at end of file
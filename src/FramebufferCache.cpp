@@ -0,0 +1,86 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FramebufferCache.hpp"
+
+namespace rack_themer {
+    FramebufferCache framebufferCache;
+
+    static void hashCombine (std::size_t& seed, std::size_t hash) { seed ^= hash + 0x9E3779B9 + (seed << 6) + (seed >> 2); }
+
+    std::size_t SharedFramebufferKey::getHash () const {
+        auto hash = std::hash<uint64_t> {} (svgId);
+        hashCombine (hash, std::hash<uint64_t> {} (themeId));
+        hashCombine (hash, ownerType->hash_code ());
+        hashCombine (hash, std::hash<float> {} (size.x));
+        hashCombine (hash, std::hash<float> {} (size.y));
+        hashCombine (hash, std::hash<float> {} (scale.x));
+        hashCombine (hash, std::hash<float> {} (scale.y));
+        hashCombine (hash, std::hash<float> {} (oversample));
+        hashCombine (hash, std::hash<float> {} (pixelRatio));
+        return hash;
+    }
+
+    // Rotating a transform changes the lengths of its axes by a few ULPs, so they're snapped to this step.
+    static constexpr float RotatedScaleStep = 1.f / 1024.f;
+
+    static float snapScale (float scale) { return std::round (scale / RotatedScaleStep) * RotatedScaleStep; }
+
+    rack::math::Vec getSharedImageScale (const float xform [6], bool rotatable) {
+        if (!rotatable)
+            return rack::math::Vec (xform [0], xform [3]);
+
+        return rack::math::Vec (snapScale (std::hypot (xform [0], xform [1])), snapScale (std::hypot (xform [2], xform [3])));
+    }
+
+    SharedFramebuffer::~SharedFramebuffer () {
+        if (fb != nullptr)
+            nvgluDeleteFramebuffer (fb);
+
+        framebufferCache.removeFramebuffer (this);
+    }
+
+    void SharedFramebuffer::invalidate () {
+        if (fb != nullptr)
+            nvgluDeleteFramebuffer (fb);
+
+        fb = nullptr;
+        rendered = false;
+    }
+
+    std::shared_ptr<SharedFramebuffer> FramebufferCache::getFramebuffer (const SharedFramebufferKey& key) {
+        auto& entry = framebuffers [key];
+        if (auto framebuffer = entry.lock ())
+            return framebuffer;
+
+        auto framebuffer = std::make_shared<SharedFramebuffer> ();
+        framebuffer->key = key;
+        entry = framebuffer;
+
+        return framebuffer;
+    }
+
+    void FramebufferCache::removeFramebuffer (const SharedFramebuffer* framebuffer) {
+        auto iter = framebuffers.find (framebuffer->key);
+
+        // The entry may already have been replaced by a new image with the same key.
+        if (iter != framebuffers.end () && iter->second.expired ())
+            framebuffers.erase (iter);
+    }
+}
\ No newline at end of file
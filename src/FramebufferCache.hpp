@@ -0,0 +1,95 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <rack.hpp>
+
+#include <memory>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace rack_themer {
+    /*
+     * Identifies the image a SharedFramebufferWidget renders. Widgets of the same type showing the same SVG with the
+     * same theme, at the same size and scale, are assumed to draw identical images.
+     * The SVG and theme are identified by their unique ids, since a freed one's address can be reused by the next.
+     */
+    struct SharedFramebufferKey {
+        uint64_t svgId = 0;
+        uint64_t themeId = 0;
+        const std::type_info* ownerType = nullptr;
+        rack::math::Vec size;
+        rack::math::Vec scale;
+        float oversample = 1.f;
+        float pixelRatio = 1.f;
+
+        bool operator== (const SharedFramebufferKey& rhs) const {
+            return svgId == rhs.svgId && themeId == rhs.themeId && *ownerType == *rhs.ownerType &&
+                   size == rhs.size && scale == rhs.scale && oversample == rhs.oversample && pixelRatio == rhs.pixelRatio;
+        }
+        std::size_t getHash () const;
+    };
+}
+
+template<>
+struct std::hash<rack_themer::SharedFramebufferKey> {
+    std::size_t operator() (const rack_themer::SharedFramebufferKey& k) const { return k.getHash (); }
+};
+
+namespace rack_themer {
+    struct SharedFramebuffer {
+        SharedFramebufferKey key;
+
+        NVGLUframebuffer* fb = nullptr;
+        // The image's bounds, in world units relative to the widget's integer position.
+        rack::math::Rect fbBox;
+        bool rendered = false;
+
+        ~SharedFramebuffer ();
+
+        // Frees the framebuffer, so whichever widget draws the image next renders it again.
+        void invalidate ();
+    };
+
+    /*
+     * Hands out the images shared by SharedFramebufferWidgets. Each image only lives as long as some widget holds it.
+     */
+    struct FramebufferCache {
+      private:
+        std::unordered_map<SharedFramebufferKey, std::weak_ptr<SharedFramebuffer>> framebuffers = {};
+
+      public:
+        std::shared_ptr<SharedFramebuffer> getFramebuffer (const SharedFramebufferKey& key);
+        void removeFramebuffer (const SharedFramebuffer* framebuffer);
+
+        int getNumFramebuffers () const { return static_cast<int> (framebuffers.size ()); }
+    };
+
+    extern FramebufferCache framebufferCache;
+
+    /*
+     * Returns the scale a SharedFramebufferWidget renders its image at under the given NanoVG transform. Rotatable
+     * images use the lengths of the transform's axes, snapped to a fixed step so that rounding errors in the rotation
+     * never change the image's key.
+     */
+    rack::math::Vec getSharedImageScale (const float xform [6], bool rotatable);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rack_themer {
+    // 64 bit FNV-1a.
+    inline uint64_t hashBytes (const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*> (data);
+        auto hash = uint64_t (0xCBF29CE484222325ull);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes [i];
+            hash *= 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+}
\ No newline at end of file
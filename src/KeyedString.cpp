@@ -20,6 +20,6 @@
 #include "ThemeCache.hpp"
 
 namespace rack_themer {
-    KeyedString getKeyedString (const std::string& text) { return themeCache.getKeyedString (text); }
-    std::string getKeyedStringText (const KeyedString& key) { return themeCache.getKeyedStringText (key); }
+    KeyedString getKeyedString (std::string_view text) { return themeCache.getKeyedString (text); }
+    std::string_view getKeyedStringText (const KeyedString& key) { return themeCache.getKeyedStringText (key); }
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MappedFile.hpp"
+
+#include <rack.hpp>
+
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace rack_themer {
+#if defined(_WIN32)
+    bool MappedFile::open (const std::string& path) {
+        close ();
+
+        auto widePath = rack::string::UTF8toUTF16 (path);
+        auto file = CreateFileW (widePath.c_str (), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx (file, &fileSize) || fileSize.QuadPart <= 0) {
+            CloseHandle (file);
+            return false;
+        }
+
+        auto mapping = CreateFileMappingW (file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle (file);
+            return false;
+        }
+
+        auto view = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            CloseHandle (mapping);
+            CloseHandle (file);
+            return false;
+        }
+
+        fileHandle = file;
+        mappingHandle = mapping;
+        data = static_cast<const uint8_t*> (view);
+        size = static_cast<size_t> (fileSize.QuadPart);
+
+        return true;
+    }
+
+    void MappedFile::close () {
+        if (data != nullptr)
+            UnmapViewOfFile (data);
+        if (mappingHandle != nullptr)
+            CloseHandle (mappingHandle);
+        if (fileHandle != nullptr)
+            CloseHandle (fileHandle);
+
+        data = nullptr;
+        size = 0;
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+    }
+#else
+    bool MappedFile::open (const std::string& path) {
+        close ();
+
+        auto file = ::open (path.c_str (), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat info;
+        if (fstat (file, &info) != 0 || info.st_size <= 0) {
+            ::close (file);
+            return false;
+        }
+
+        auto view = mmap (nullptr, static_cast<size_t> (info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping stays valid after the file is closed.
+        ::close (file);
+        if (view == MAP_FAILED)
+            return false;
+
+        data = static_cast<const uint8_t*> (view);
+        size = static_cast<size_t> (info.st_size);
+
+        return true;
+    }
+
+    void MappedFile::close () {
+        if (data != nullptr)
+            munmap (const_cast<uint8_t*> (data), size);
+
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    bool readFile (const std::string& path, std::vector<char>& data) {
+        auto file = std::fopen (path.c_str (), "rb");
+        if (file == nullptr)
+            return false;
+
+        std::fseek (file, 0, SEEK_END);
+        auto size = std::ftell (file);
+        std::fseek (file, 0, SEEK_SET);
+
+        auto read = size_t (0);
+        if (size >= 0) {
+            data.resize (static_cast<size_t> (size) + 1);
+            read = std::fread (data.data (), 1, static_cast<size_t> (size), file);
+            data [read] = '\0';
+        }
+
+        std::fclose (file);
+        return size >= 0 && read == static_cast<size_t> (size);
+    }
+}
\ No newline at end of file
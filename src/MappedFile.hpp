@@ -0,0 +1,54 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rack_themer {
+    /** A read-only memory mapping of a whole file, unmapped when destroyed. */
+    struct MappedFile {
+      private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+#if defined(_WIN32)
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+
+      public:
+        MappedFile () { }
+        MappedFile (const MappedFile&) = delete;
+        MappedFile& operator= (const MappedFile&) = delete;
+        ~MappedFile () { close (); }
+
+        /** Maps the file, replacing any previous mapping. Empty files can't be mapped. */
+        bool open (const std::string& path);
+        void close ();
+
+        const uint8_t* getData () const { return data; }
+        size_t getSize () const { return size; }
+    };
+
+    /** Reads the whole file, followed by a null terminator so text can be parsed in place. */
+    bool readFile (const std::string& path, std::vector<char>& data);
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParseCache.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "SvgBinary.hpp"
+#include "ThemeBinary.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+namespace rack_themer {
+    static constexpr uint32_t EntryMagic = 0x43505452; // "RTPC"
+    static constexpr uint32_t EntryVersion = 1;
+
+    static constexpr const char* SvgExtension = ".svgb";
+    static constexpr const char* ThemeExtension = ".themeb";
+
+    // Padded to a multiple of 8 bytes, so the binary after it stays aligned.
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint64_t payloadHash;
+    };
+
+    static_assert (sizeof (EntryHeader) % 8 == 0, "Parse cache entry headers must keep the binary after them aligned");
+
+    const std::string& ParseCache::getDirectory () {
+        std::call_once (directoryFlag, [this] { directory = rack::asset::user ("RackThemer/ParseCache"); });
+        return directory;
+    }
+
+    std::string ParseCache::getEntryPath (uint64_t sourceHash, uint32_t formatVersion, const char* extension) {
+        // Libraries with other format versions keep their own entries, instead of overwriting each other's.
+        auto filename = rack::string::f ("%016llx-v%u%s", static_cast<unsigned long long> (sourceHash), formatVersion, extension);
+        return rack::system::join (getDirectory (), filename);
+    }
+
+    template<typename TLoad>
+    auto ParseCache::load (const std::string& entryPath, uint64_t sourceHash, size_t sourceSize, TLoad&& deserialize) -> decltype (deserialize (nullptr, 0)) {
+        if (!enabled)
+            return nullptr;
+
+        auto file = MappedFile ();
+        if (!file.open (entryPath))
+            return nullptr;
+
+        auto result = decltype (deserialize (nullptr, 0)) ();
+        if (file.getSize () >= sizeof (EntryHeader)) {
+            const auto& header = *reinterpret_cast<const EntryHeader*> (file.getData ());
+            auto payload = file.getData () + sizeof (EntryHeader);
+            auto payloadSize = file.getSize () - sizeof (EntryHeader);
+
+            auto isValid =
+                header.magic == EntryMagic &&
+                header.version == EntryVersion &&
+                header.sourceHash == sourceHash &&
+                header.sourceSize == sourceSize &&
+                header.payloadHash == hashBytes (payload, payloadSize);
+
+            if (isValid)
+                result = deserialize (payload, payloadSize);
+        }
+
+        if (result == nullptr) {
+            WARN ("Parse cache entry %s is stale or corrupt, rebuilding it", entryPath.c_str ());
+            file.close ();
+            rack::system::remove (entryPath);
+        }
+
+        return result;
+    }
+
+    void ParseCache::store (const std::string& entryPath, uint64_t sourceHash, size_t sourceSize, const std::vector<uint8_t>& payload) {
+        if (!enabled)
+            return;
+
+        rack::system::createDirectories (getDirectory ());
+
+        auto header = EntryHeader ();
+        header.magic = EntryMagic;
+        header.version = EntryVersion;
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.payloadHash = hashBytes (payload.data (), payload.size ());
+
+        // Written to a file of its own first, so other threads and processes never see a partial entry.
+        auto threadHash = std::hash<std::thread::id> {} (std::this_thread::get_id ());
+        auto tempPath = entryPath + rack::string::f (".%zx.tmp", threadHash);
+
+        auto file = std::fopen (tempPath.c_str (), "wb");
+        if (file == nullptr)
+            return;
+
+        auto written = std::fwrite (&header, sizeof (header), 1, file) == 1 &&
+                       std::fwrite (payload.data (), 1, payload.size (), file) == payload.size ();
+        auto closed = std::fclose (file) == 0;
+
+        if (!written || !closed || !rack::system::rename (tempPath, entryPath)) {
+            WARN ("Failed to write parse cache entry %s", entryPath.c_str ());
+            rack::system::remove (tempPath);
+        }
+    }
+
+    void ParseCache::clear () {
+        const auto& cacheDirectory = getDirectory ();
+        if (!rack::system::isDirectory (cacheDirectory))
+            return;
+
+        for (const auto& path : rack::system::getEntries (cacheDirectory)) {
+            auto extension = rack::system::getExtension (path);
+            if (extension == SvgExtension || extension == ThemeExtension || extension == ".tmp")
+                rack::system::remove (path);
+        }
+    }
+
+    std::shared_ptr<ThemeableSvg> ParseCache::loadSvg (uint64_t sourceHash, size_t sourceSize) {
+        auto entryPath = getEntryPath (sourceHash, SvgBinary::FormatVersion, SvgExtension);
+        return load (entryPath, sourceHash, sourceSize, SvgBinary::deserialize);
+    }
+
+    std::shared_ptr<RackTheme> ParseCache::loadTheme (uint64_t sourceHash, size_t sourceSize) {
+        auto entryPath = getEntryPath (sourceHash, ThemeBinary::FormatVersion, ThemeExtension);
+        return load (entryPath, sourceHash, sourceSize, ThemeBinary::deserialize);
+    }
+
+    void ParseCache::storeSvg (uint64_t sourceHash, size_t sourceSize, const ThemeableSvg& svg) {
+        if (enabled)
+            store (getEntryPath (sourceHash, SvgBinary::FormatVersion, SvgExtension), sourceHash, sourceSize, SvgBinary::serialize (svg));
+    }
+
+    void ParseCache::storeTheme (uint64_t sourceHash, size_t sourceSize, const RackTheme& theme) {
+        if (enabled)
+            store (getEntryPath (sourceHash, ThemeBinary::FormatVersion, ThemeExtension), sourceHash, sourceSize, ThemeBinary::serialize (theme));
+    }
+}
\ No newline at end of file
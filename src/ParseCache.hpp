@@ -0,0 +1,65 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rack_themer {
+    /*
+     * Keeps the compiled binary of every SVG and theme that gets parsed in Rack's user folder, so later launches can
+     * load them without parsing. Entries are named after a hash of their source file's contents and the binary
+     * format's version, and start with a header recording the source's hash and size and a hash of the binary.
+     * Entries that don't match their source, or fail any check, are deleted and written again once the source has
+     * been parsed.
+     */
+    struct ParseCache {
+      private:
+        std::atomic<bool> enabled = true;
+        std::once_flag directoryFlag;
+        std::string directory;
+
+        const std::string& getDirectory ();
+        std::string getEntryPath (uint64_t sourceHash, uint32_t formatVersion, const char* extension);
+
+        template<typename TLoad>
+        auto load (const std::string& entryPath, uint64_t sourceHash, size_t sourceSize, TLoad&& deserialize) -> decltype (deserialize (nullptr, 0));
+        void store (const std::string& entryPath, uint64_t sourceHash, size_t sourceSize, const std::vector<uint8_t>& payload);
+
+      public:
+        void setEnabled (bool enabled) { this->enabled = enabled; }
+        bool isEnabled () { return enabled; }
+        void clear ();
+
+        // Both return null on a miss.
+        std::shared_ptr<ThemeableSvg> loadSvg (uint64_t sourceHash, size_t sourceSize);
+        std::shared_ptr<RackTheme> loadTheme (uint64_t sourceHash, size_t sourceSize);
+        void storeSvg (uint64_t sourceHash, size_t sourceSize, const ThemeableSvg& svg);
+        void storeTheme (uint64_t sourceHash, size_t sourceSize, const RackTheme& theme);
+    };
+
+    extern ParseCache parseCache;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "rack_themer.hpp"
+#include "ParseCache.hpp"
+#include "ThemeCache.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace rack_themer {
+    void PreloadManifest::addSvgDirectory (const std::string& directory, bool recursive) {
+        for (const auto& path : rack::system::getEntries (directory, recursive ? -1 : 0)) {
+            auto extension = rack::system::getExtension (path);
+            std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+
+            if (extension == ".svg" && rack::system::isFile (path))
+                svgPaths.push_back (path);
+        }
+    }
+
+    PreloadResult preloadAssets (const PreloadManifest& manifest) { return themeCache.preload (manifest); }
+    void shutdown () { workerPool.shutdown (); }
+
+    void setParseCacheEnabled (bool enabled) { parseCache.setEnabled (enabled); }
+    bool isParseCacheEnabled () { return parseCache.isEnabled (); }
+    void clearParseCache () { parseCache.clear (); }
+}
\ No newline at end of file
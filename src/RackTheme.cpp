@@ -18,11 +18,20 @@
  */
 
 #include "rack_themer.hpp"
+#include "ThemeBinary.hpp"
 #include "ThemeCache.hpp"
 
 namespace rack_themer {
     std::shared_ptr<RackTheme> getNullTheme () { return themeCache.getRackTheme (""); }
     std::shared_ptr<RackTheme> loadRackTheme (const std::string& path) { return themeCache.getRackTheme (path); }
+    std::shared_future<std::shared_ptr<RackTheme>> loadRackThemeAsync (const std::string& path) { return themeCache.getRackThemeAsync (path); }
+
+    std::string getCompiledThemePath (const std::string& themePath) {
+        auto extension = rack::system::getExtension (themePath);
+        return themePath.substr (0, themePath.size () - extension.size ()) + ".themeb";
+    }
+
+    bool compileRackTheme (const std::string& themePath) { return ThemeBinary::compile (themePath, getCompiledThemePath (themePath)); }
 
     std::shared_ptr<Style> RackTheme::getIdStyle (const KeyedString& name) const {
         if (auto found = idStyles.find (name); found != idStyles.end ())
@@ -57,10 +66,13 @@ namespace rack_themer {
             }
 
             case PaintKind::Gradient: {
-                auto ret = basePaint;
                 auto gradient = getGradient ();
+                if (gradient->nstops < 1)
+                    return NVGpaint ();
+
+                auto ret = basePaint;
                 ret.innerColor = gradient->stops [0].color;
-                ret.outerColor = gradient->stops [gradient->nstops].color;
+                ret.outerColor = gradient->stops [gradient->nstops - 1].color;
 
                 return ret;
             }
@@ -0,0 +1,196 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace rack_themer {
+    /*
+     * An unordered_map split into shards, each behind its own reader-writer lock. Lookups only take a shared lock on
+     * one shard, so readers never block each other, and writers only block readers of the same shard. Locks are only
+     * ever held to read or write the maps themselves, never while making a value.
+     */
+    template<typename TKey, typename TValue, typename THash = std::hash<TKey>>
+    struct ShardedMap {
+      private:
+        static constexpr int ShardBits = 4;
+        static constexpr int NumShards = 1 << ShardBits;
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<TKey, TValue, THash> map;
+            // Values getOrCreate is still making, for anyone else asking for the same key to wait on.
+            std::unordered_map<TKey, std::shared_future<TValue>, THash> pending;
+        };
+
+        std::array<Shard, NumShards> shards;
+
+        // The maps use the low bits of the hash for their buckets, so the shard is picked from the high bits of a
+        // scrambled copy instead.
+        static std::size_t getShardIndex (const TKey& key) {
+            auto hash = static_cast<uint64_t> (THash {} (key));
+            return static_cast<std::size_t> ((hash * 0x9E3779B97F4A7C15ull) >> (64 - ShardBits));
+        }
+
+        Shard& getShard (const TKey& key) { return shards [getShardIndex (key)]; }
+        const Shard& getShard (const TKey& key) const { return shards [getShardIndex (key)]; }
+
+      public:
+        bool find (const TKey& key, TValue& value) const {
+            const auto& shard = getShard (key);
+            std::shared_lock lock (shard.mutex);
+
+            auto search = shard.map.find (key);
+            if (search == shard.map.end ())
+                return false;
+
+            value = search->second;
+            return true;
+        }
+
+        void set (const TKey& key, TValue value) {
+            auto& shard = getShard (key);
+            std::unique_lock lock (shard.mutex);
+            shard.map [key] = std::move (value);
+        }
+
+        bool erase (const TKey& key) {
+            auto& shard = getShard (key);
+            std::unique_lock lock (shard.mutex);
+            return shard.map.erase (key) > 0;
+        }
+
+        /*
+         * Erases the entry for key if shouldErase (value) returns true. The check and the erase happen under the same
+         * write lock, so nobody can look the value up in between.
+         */
+        template<typename TPredicate>
+        bool eraseIf (const TKey& key, TPredicate&& shouldErase) {
+            auto& shard = getShard (key);
+            std::unique_lock lock (shard.mutex);
+
+            auto search = shard.map.find (key);
+            if (search == shard.map.end () || !shouldErase (search->second))
+                return false;
+
+            shard.map.erase (search);
+            return true;
+        }
+
+        /*
+         * Erases every entry for which shouldErase (key, value) returns true, locking one shard at a time.
+         */
+        template<typename TPredicate>
+        void eraseWhere (TPredicate&& shouldErase) {
+            for (auto& shard : shards) {
+                std::unique_lock lock (shard.mutex);
+                for (auto iter = shard.map.begin (); iter != shard.map.end ();) {
+                    if (shouldErase (iter->first, iter->second))
+                        iter = shard.map.erase (iter);
+                    else
+                        iter++;
+                }
+            }
+        }
+
+        /*
+         * Returns the value for key, calling create (TValue&) to make it on a miss. create returns whether the new
+         * value should be stored. Each value is only made once: callers asking for a key that's still being made wait
+         * for it, and get the same result even if it wasn't stored. create runs without holding any lock, so lookups
+         * of other keys never wait on it, and it may use this map for any key except its own.
+         */
+        template<typename TCreate>
+        TValue getOrCreate (const TKey& key, TCreate&& create) {
+            auto value = TValue ();
+            if (find (key, value))
+                return value;
+
+            auto& shard = getShard (key);
+            auto promise = std::promise<TValue> ();
+
+            {
+                std::unique_lock lock (shard.mutex);
+
+                // Someone else may have made it while we were waiting for the lock, or may be making it now.
+                if (auto search = shard.map.find (key); search != shard.map.end ())
+                    return search->second;
+
+                if (auto search = shard.pending.find (key); search != shard.pending.end ()) {
+                    auto future = search->second;
+                    lock.unlock ();
+                    return future.get ();
+                }
+
+                shard.pending.emplace (key, promise.get_future ().share ());
+            }
+
+            auto stored = false;
+            try {
+                stored = create (value);
+            } catch (...) {
+                {
+                    std::unique_lock lock (shard.mutex);
+                    shard.pending.erase (key);
+                }
+
+                promise.set_exception (std::current_exception ());
+                throw;
+            }
+
+            {
+                std::unique_lock lock (shard.mutex);
+                if (stored)
+                    shard.map [key] = value;
+
+                shard.pending.erase (key);
+            }
+
+            promise.set_value (value);
+            return value;
+        }
+
+        /*
+         * Calls callback (key, value) for every entry, locking one shard at a time. The callback must not modify
+         * this map.
+         */
+        template<typename TCallback>
+        void forEach (TCallback&& callback) const {
+            for (const auto& shard : shards) {
+                std::shared_lock lock (shard.mutex);
+                for (const auto& [key, value] : shard.map)
+                    callback (key, value);
+            }
+        }
+
+        void clear () {
+            for (auto& shard : shards) {
+                std::unique_lock lock (shard.mutex);
+                shard.map.clear ();
+            }
+        }
+    };
+}
\ No newline at end of file
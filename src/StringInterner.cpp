@@ -0,0 +1,99 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StringInterner.hpp"
+
+#include <cstring>
+#include <mutex>
+
+namespace rack_themer {
+    StringInterner::StringInterner () : viewChunks (new std::atomic<std::string_view*> [MaxViewChunks]) {
+        for (int i = 0; i < MaxViewChunks; i++)
+            viewChunks [i].store (nullptr, std::memory_order_relaxed);
+    }
+
+    StringInterner::~StringInterner () {
+        for (int i = 0; i < MaxViewChunks; i++)
+            delete [] viewChunks [i].load (std::memory_order_relaxed);
+    }
+
+    std::string_view StringInterner::copyToArena (std::string_view text) {
+        if (text.empty ())
+            return std::string_view ();
+
+        // Strings too long for a block get one of their own, so the current block keeps its free space.
+        if (text.size () > ArenaBlockSize / 4) {
+            auto& block = arenaBlocks.emplace_back (new char [text.size ()]);
+            std::memcpy (block.get (), text.data (), text.size ());
+            return std::string_view (block.get (), text.size ());
+        }
+
+        if (text.size () > arenaLeft) {
+            arenaHead = arenaBlocks.emplace_back (new char [ArenaBlockSize]).get ();
+            arenaLeft = ArenaBlockSize;
+        }
+
+        auto copy = arenaHead;
+        std::memcpy (copy, text.data (), text.size ());
+        arenaHead += text.size ();
+        arenaLeft -= text.size ();
+
+        return std::string_view (copy, text.size ());
+    }
+
+    unsigned int StringInterner::intern (std::string_view text) {
+        {
+            std::shared_lock lock (mutex);
+            auto iter = ids.find (text);
+            if (iter != ids.end ())
+                return iter->second;
+        }
+
+        std::unique_lock lock (mutex);
+        auto iter = ids.find (text);
+        if (iter != ids.end ())
+            return iter->second;
+
+        auto id = numIds.load (std::memory_order_relaxed);
+        auto chunkIndex = id >> ViewChunkBits;
+        // Out of ids. Callers get the invalid id rather than a wrong string.
+        if (chunkIndex >= static_cast<unsigned int> (MaxViewChunks))
+            return 0;
+
+        auto chunk = viewChunks [chunkIndex].load (std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            chunk = new std::string_view [ViewChunkSize];
+            viewChunks [chunkIndex].store (chunk, std::memory_order_release);
+        }
+
+        auto view = copyToArena (text);
+        chunk [id & (ViewChunkSize - 1)] = view;
+        ids.emplace (view, id);
+        numIds.store (id + 1, std::memory_order_release);
+
+        return id;
+    }
+
+    std::string_view StringInterner::getText (unsigned int id) const {
+        if (id == 0 || id >= numIds.load (std::memory_order_acquire))
+            return std::string_view ();
+
+        auto chunk = viewChunks [id >> ViewChunkBits].load (std::memory_order_acquire);
+        return chunk [id & (ViewChunkSize - 1)];
+    }
+}
\ No newline at end of file
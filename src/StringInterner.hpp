@@ -0,0 +1,66 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rack_themer {
+    /*
+     * Interns strings as dense ids, starting at 1. The text is copied into an append-only arena that is never moved
+     * or freed, so views of it stay valid for as long as the interner lives, and looking up an id's text is an array
+     * index that never takes a lock.
+     */
+    struct StringInterner {
+      private:
+        static constexpr size_t ArenaBlockSize = 64 * 1024;
+        static constexpr int ViewChunkBits = 10;
+        static constexpr unsigned int ViewChunkSize = 1u << ViewChunkBits;
+        static constexpr int MaxViewChunks = 16 * 1024;
+
+        // Guards interning. Lookups of existing strings only take it shared.
+        std::shared_mutex mutex;
+        // Keys are views into the arena.
+        std::unordered_map<std::string_view, unsigned int> ids;
+
+        std::vector<std::unique_ptr<char []>> arenaBlocks;
+        char* arenaHead = nullptr;
+        size_t arenaLeft = 0;
+
+        // Each id's text, in chunks that are never moved once allocated. Published ids are below numIds.
+        std::unique_ptr<std::atomic<std::string_view*> []> viewChunks;
+        std::atomic<unsigned int> numIds = 1;
+
+        std::string_view copyToArena (std::string_view text);
+
+      public:
+        StringInterner ();
+        StringInterner (const StringInterner&) = delete;
+        ~StringInterner ();
+
+        // Returns 0 only if every id is taken.
+        unsigned int intern (std::string_view text);
+        // Returns an empty view for ids that were never interned.
+        std::string_view getText (unsigned int id) const;
+    };
+}
\ No newline at end of file
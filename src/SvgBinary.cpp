@@ -0,0 +1,439 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SvgBinary.hpp"
+#include "DrawProgram.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+
+#include <nanosvg.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace rack_themer {
+    static constexpr uint32_t BinaryMagic = 0x56535452; // "RTSV"
+    // Written as a number, so files from a machine with the other byte order are rejected.
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+    // Shape flags
+    static constexpr uint32_t ShapeVisible = 1 << 0;
+    static constexpr uint32_t ShapeEvenOdd = 1 << 1;
+
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t byteOrder;
+        // The size and hash of the file it was compiled from, or zero if unknown.
+        uint32_t sourceSize;
+        uint64_t sourceHash;
+
+        float width;
+        float height;
+
+        uint32_t numShapes;
+        uint32_t numPaths;
+        uint32_t numGradients;
+        uint32_t numPoints;
+        uint32_t numSegments;
+        uint32_t numStringBytes;
+
+        // ThemeableSvg::numPaths and numPoints, which count what the original image had.
+        int32_t totalPaths;
+        int32_t totalPoints;
+        float minFeatureSize;
+        float minStrokeWidth;
+    };
+
+    struct BinaryString {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct BinaryPaint {
+        int32_t type;
+        uint32_t color;
+        int32_t numStops;
+        uint32_t firstStopColor;
+        uint32_t lastStopColor;
+    };
+
+    struct BinaryShape {
+        // The shape's full id, and the two parts it's split into.
+        BinaryString id;
+        BinaryString shapeId;
+        BinaryString styleClass;
+
+        uint32_t flags;
+        int32_t fillGradient;
+        int32_t strokeGradient;
+        int32_t firstPath;
+        int32_t numPaths;
+        float bounds [4];
+
+        BinaryPaint fill;
+        BinaryPaint stroke;
+        float opacity;
+        float strokeWidth;
+        int32_t strokeLineCap;
+        int32_t strokeLineJoin;
+    };
+
+    struct BinaryPath {
+        int32_t firstPoint;
+        int32_t numPoints;
+        int32_t firstSegment;
+        uint32_t closed;
+        int32_t winding;
+        float bounds [4];
+    };
+
+    struct BinaryGradient {
+        uint32_t radial;
+        float start [2];
+        float end [2];
+        float radius;
+    };
+
+    static_assert (sizeof (BinaryHeader) % 4 == 0 && sizeof (BinaryShape) % 4 == 0 &&
+                   sizeof (BinaryPath) % 4 == 0 && sizeof (BinaryGradient) % 4 == 0,
+                   "Compiled SVG records must keep the tables after them 4 byte aligned");
+
+    struct BinaryLayout {
+        size_t shapes, paths, gradients, points, segments, strings, size;
+
+        BinaryLayout (const BinaryHeader& header) {
+            shapes = sizeof (BinaryHeader);
+            paths = shapes + header.numShapes * sizeof (BinaryShape);
+            gradients = paths + header.numPaths * sizeof (BinaryPath);
+            points = gradients + header.numGradients * sizeof (BinaryGradient);
+            segments = points + header.numPoints * 2 * sizeof (float);
+            strings = segments + header.numSegments;
+            size = strings + header.numStringBytes;
+        }
+    };
+
+    static BinaryPaint toBinary (const SvgPaint& paint) {
+        return { paint.type, paint.color, paint.numStops, paint.firstStopColor, paint.lastStopColor };
+    }
+
+    static SvgPaint fromBinary (const BinaryPaint& binaryPaint) {
+        auto paint = SvgPaint ();
+        paint.type = binaryPaint.type;
+        paint.color = binaryPaint.color;
+        paint.numStops = binaryPaint.numStops;
+        paint.firstStopColor = binaryPaint.firstStopColor;
+        paint.lastStopColor = binaryPaint.lastStopColor;
+        return paint;
+    }
+
+    template<typename T>
+    static void append (std::vector<uint8_t>& data, const T* values, size_t count) {
+        auto bytes = reinterpret_cast<const uint8_t*> (values);
+        data.insert (data.end (), bytes, bytes + count * sizeof (T));
+    }
+
+    std::vector<uint8_t> SvgBinary::serialize (const ThemeableSvg& svg, uint64_t sourceHash, size_t sourceSize) {
+        std::string strings;
+        auto addString = [&] (std::string_view text) {
+            auto binaryString = BinaryString { static_cast<uint32_t> (strings.size ()), static_cast<uint32_t> (text.size ()) };
+            strings.append (text);
+            return binaryString;
+        };
+
+        std::vector<BinaryShape> shapes;
+        shapes.reserve (svg.shapes.size ());
+        for (const auto& shape : svg.shapes) {
+            auto& binaryShape = shapes.emplace_back ();
+            binaryShape.id = addString (shape.source != nullptr ? shape.source->id : "");
+            binaryShape.shapeId = addString (getKeyedStringText (shape.shapeId));
+            binaryShape.styleClass = addString (getKeyedStringText (shape.styleClass));
+
+            binaryShape.flags = (shape.visible ? ShapeVisible : 0) | (shape.evenOdd ? ShapeEvenOdd : 0);
+            binaryShape.fillGradient = shape.fillGradient;
+            binaryShape.strokeGradient = shape.strokeGradient;
+            binaryShape.firstPath = shape.firstPath;
+            binaryShape.numPaths = shape.numPaths;
+            std::copy (shape.bounds, shape.bounds + 4, binaryShape.bounds);
+
+            binaryShape.fill = toBinary (shape.fill);
+            binaryShape.stroke = toBinary (shape.stroke);
+            binaryShape.opacity = shape.opacity;
+            binaryShape.strokeWidth = shape.strokeWidth;
+            binaryShape.strokeLineCap = shape.strokeLineCap;
+            binaryShape.strokeLineJoin = shape.strokeLineJoin;
+        }
+
+        std::vector<BinaryPath> paths;
+        paths.reserve (svg.paths.size ());
+        for (const auto& path : svg.paths) {
+            auto& binaryPath = paths.emplace_back ();
+            binaryPath.firstPoint = path.firstPoint;
+            binaryPath.numPoints = path.numPoints;
+            binaryPath.firstSegment = path.firstSegment;
+            binaryPath.closed = path.closed ? 1 : 0;
+            binaryPath.winding = path.winding;
+            std::copy (path.bounds, path.bounds + 4, binaryPath.bounds);
+        }
+
+        std::vector<BinaryGradient> gradients;
+        gradients.reserve (svg.gradients.size ());
+        for (const auto& gradient : svg.gradients) {
+            gradients.push_back ({
+                gradient.radial ? 1u : 0u,
+                { gradient.start.x, gradient.start.y },
+                { gradient.end.x, gradient.end.y },
+                gradient.radius,
+            });
+        }
+
+        auto header = BinaryHeader ();
+        header.magic = BinaryMagic;
+        header.version = FormatVersion;
+        header.byteOrder = ByteOrderMark;
+        header.sourceSize = static_cast<uint32_t> (sourceSize);
+        header.sourceHash = sourceHash;
+        header.width = svg.size.x;
+        header.height = svg.size.y;
+        header.numShapes = static_cast<uint32_t> (shapes.size ());
+        header.numPaths = static_cast<uint32_t> (paths.size ());
+        header.numGradients = static_cast<uint32_t> (gradients.size ());
+        header.numPoints = static_cast<uint32_t> (svg.points.size () / 2);
+        header.numSegments = static_cast<uint32_t> (svg.segmentLodTiers.size ());
+        header.numStringBytes = static_cast<uint32_t> (strings.size ());
+        header.totalPaths = svg.numPaths;
+        header.totalPoints = svg.numPoints;
+        header.minFeatureSize = svg.metrics.minFeatureSize;
+        header.minStrokeWidth = svg.metrics.minStrokeWidth;
+
+        std::vector<uint8_t> data;
+        data.reserve (BinaryLayout (header).size);
+        append (data, &header, 1);
+        append (data, shapes.data (), shapes.size ());
+        append (data, paths.data (), paths.size ());
+        append (data, gradients.data (), gradients.size ());
+        append (data, svg.points.data (), 2 * header.numPoints);
+        append (data, svg.segmentLodTiers.data (), svg.segmentLodTiers.size ());
+        append (data, strings.data (), strings.size ());
+
+        return data;
+    }
+
+    static bool isValidString (const BinaryString& string, const BinaryHeader& header) {
+        return string.offset <= header.numStringBytes && string.length <= header.numStringBytes - string.offset;
+    }
+
+    static bool isValidRange (int32_t first, int32_t count, uint32_t tableSize) {
+        return first >= 0 && count >= 0 && static_cast<uint64_t> (first) + static_cast<uint64_t> (count) <= tableSize;
+    }
+
+    static bool isValidGradient (int32_t gradient, const BinaryHeader& header) {
+        return gradient == -1 || (gradient >= 0 && static_cast<uint32_t> (gradient) < header.numGradients);
+    }
+
+    // Checks every index in the file, so a corrupt file can't make drawing read out of bounds.
+    static bool isValid (const uint8_t* data, size_t size) {
+        if (size < sizeof (BinaryHeader))
+            return false;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        if (header.magic != BinaryMagic || header.version != SvgBinary::FormatVersion || header.byteOrder != ByteOrderMark)
+            return false;
+
+        auto layout = BinaryLayout (header);
+        if (layout.size != size)
+            return false;
+
+        auto shapes = reinterpret_cast<const BinaryShape*> (data + layout.shapes);
+        for (uint32_t i = 0; i < header.numShapes; i++) {
+            const auto& shape = shapes [i];
+            if (!isValidString (shape.id, header) || !isValidString (shape.shapeId, header) || !isValidString (shape.styleClass, header))
+                return false;
+            if (!isValidRange (shape.firstPath, shape.numPaths, header.numPaths))
+                return false;
+            if (!isValidGradient (shape.fillGradient, header) || !isValidGradient (shape.strokeGradient, header))
+                return false;
+        }
+
+        auto paths = reinterpret_cast<const BinaryPath*> (data + layout.paths);
+        for (uint32_t i = 0; i < header.numPaths; i++) {
+            const auto& path = paths [i];
+            if (!isValidRange (path.firstPoint, path.numPoints, header.numPoints))
+                return false;
+            // A starting point, then three points and one tier for every curve of the path.
+            if (path.numPoints < 1 || (path.numPoints - 1) % 3 != 0)
+                return false;
+            if (!isValidRange (path.firstSegment, (path.numPoints - 1) / 3, header.numSegments))
+                return false;
+            if (path.winding != NVG_SOLID && path.winding != NVG_HOLE)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool SvgBinary::getSource (const uint8_t* data, size_t size, uint64_t& sourceHash, size_t& sourceSize) {
+        if (!isValid (data, size))
+            return false;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        sourceHash = header.sourceHash;
+        sourceSize = header.sourceSize;
+        return sourceHash != 0 || sourceSize != 0;
+    }
+
+    std::shared_ptr<ThemeableSvg> SvgBinary::deserialize (const uint8_t* data, size_t size) {
+        if (!isValid (data, size))
+            return nullptr;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        auto layout = BinaryLayout (header);
+        auto binaryShapes = reinterpret_cast<const BinaryShape*> (data + layout.shapes);
+        auto binaryPaths = reinterpret_cast<const BinaryPath*> (data + layout.paths);
+        auto binaryGradients = reinterpret_cast<const BinaryGradient*> (data + layout.gradients);
+        auto binaryPoints = reinterpret_cast<const float*> (data + layout.points);
+        auto strings = reinterpret_cast<const char*> (data + layout.strings);
+
+        auto getString = [&] (const BinaryString& string) { return std::string_view (strings + string.offset, string.length); };
+
+        auto svg = std::make_shared<ThemeableSvg> ();
+        svg->size = rack::math::Vec (header.width, header.height);
+        svg->numPaths = header.totalPaths;
+        svg->numPoints = header.totalPoints;
+        svg->metrics.minFeatureSize = header.minFeatureSize;
+        svg->metrics.minStrokeWidth = header.minStrokeWidth;
+        svg->metrics.numPoints = header.totalPoints;
+
+        // Every table is a single allocation.
+        svg->shapes.resize (header.numShapes);
+        svg->shapeStandIns.resize (header.numShapes);
+        for (uint32_t i = 0; i < header.numShapes; i++) {
+            const auto& binaryShape = binaryShapes [i];
+            auto& shape = svg->shapes [i];
+            auto& standIn = svg->shapeStandIns [i];
+
+            auto id = getString (binaryShape.id);
+            auto idLength = std::min (id.size (), sizeof (standIn.id) - 1);
+            std::memcpy (standIn.id, id.data (), idLength);
+            standIn.id [idLength] = '\0';
+            standIn.flags = (binaryShape.flags & ShapeVisible) != 0 ? NSVG_FLAGS_VISIBLE : 0;
+            standIn.fillRule = (binaryShape.flags & ShapeEvenOdd) != 0 ? NSVG_FILLRULE_EVENODD : NSVG_FILLRULE_NONZERO;
+            std::copy (binaryShape.bounds, binaryShape.bounds + 4, standIn.bounds);
+            standIn.next = i + 1 < header.numShapes ? &svg->shapeStandIns [i + 1] : nullptr;
+
+            shape.source = &standIn;
+            shape.shapeId = getKeyedString (getString (binaryShape.shapeId));
+            shape.styleClass = getKeyedString (getString (binaryShape.styleClass));
+            shape.visible = (binaryShape.flags & ShapeVisible) != 0;
+            shape.evenOdd = (binaryShape.flags & ShapeEvenOdd) != 0;
+            shape.fillGradient = binaryShape.fillGradient;
+            shape.strokeGradient = binaryShape.strokeGradient;
+            shape.firstPath = binaryShape.firstPath;
+            shape.numPaths = binaryShape.numPaths;
+            std::copy (binaryShape.bounds, binaryShape.bounds + 4, shape.bounds);
+
+            shape.fill = fromBinary (binaryShape.fill);
+            shape.stroke = fromBinary (binaryShape.stroke);
+            shape.opacity = binaryShape.opacity;
+            shape.strokeWidth = binaryShape.strokeWidth;
+            shape.strokeLineCap = binaryShape.strokeLineCap;
+            shape.strokeLineJoin = binaryShape.strokeLineJoin;
+        }
+
+        svg->paths.resize (header.numPaths);
+        for (uint32_t i = 0; i < header.numPaths; i++) {
+            const auto& binaryPath = binaryPaths [i];
+            auto& path = svg->paths [i];
+
+            path.firstPoint = binaryPath.firstPoint;
+            path.numPoints = binaryPath.numPoints;
+            path.firstSegment = binaryPath.firstSegment;
+            path.closed = binaryPath.closed != 0;
+            path.winding = static_cast<NVGsolidity> (binaryPath.winding);
+            std::copy (binaryPath.bounds, binaryPath.bounds + 4, path.bounds);
+        }
+
+        svg->gradients.resize (header.numGradients);
+        for (uint32_t i = 0; i < header.numGradients; i++) {
+            const auto& binaryGradient = binaryGradients [i];
+            auto& gradient = svg->gradients [i];
+
+            gradient.radial = binaryGradient.radial != 0;
+            gradient.start = rack::math::Vec (binaryGradient.start [0], binaryGradient.start [1]);
+            gradient.end = rack::math::Vec (binaryGradient.end [0], binaryGradient.end [1]);
+            gradient.radius = binaryGradient.radius;
+        }
+
+        svg->points.assign (binaryPoints, binaryPoints + 2 * header.numPoints);
+        svg->segmentLodTiers.assign (data + layout.segments, data + layout.segments + header.numSegments);
+
+        svg->memoryUsage = sizeof (ThemeableSvg) +
+                           svg->shapes.capacity () * (sizeof (NSVGshape) + sizeof (SvgShape)) +
+                           svg->paths.capacity () * sizeof (SvgPath) +
+                           svg->points.capacity () * sizeof (float) +
+                           svg->segmentLodTiers.capacity () * sizeof (uint8_t) +
+                           svg->gradients.capacity () * sizeof (SvgGradient);
+
+        return svg;
+    }
+
+    bool SvgBinary::save (const ThemeableSvg& svg, const std::string& path, uint64_t sourceHash, size_t sourceSize) {
+        auto data = serialize (svg, sourceHash, sourceSize);
+
+        auto file = std::fopen (path.c_str (), "wb");
+        if (file == nullptr)
+            return false;
+
+        auto written = std::fwrite (data.data (), 1, data.size (), file);
+        // A partially written file fails the size check when it's loaded.
+        auto closed = std::fclose (file) == 0;
+
+        return closed && written == data.size ();
+    }
+
+    bool SvgBinary::compile (const std::string& svgPath, const std::string& binaryPath) {
+        std::vector<char> data;
+        if (!readFile (svgPath, data)) {
+            WARN ("Failed to read SVG %s", svgPath.c_str ());
+            return false;
+        }
+
+        // Hashed before NanoSVG parses the text in place.
+        auto sourceSize = data.size () - 1;
+        auto sourceHash = hashBytes (data.data (), sourceSize);
+
+        auto handle = nsvgParse (data.data (), "px", rack::window::SVG_DPI);
+        if (handle == nullptr) {
+            WARN ("Failed to load SVG %s", svgPath.c_str ());
+            return false;
+        }
+
+        auto svg = ThemeableSvg ();
+        svg.handle = handle;
+        svg.buildGeometry ();
+
+        if (!save (svg, binaryPath, sourceHash, sourceSize)) {
+            WARN ("Failed to write compiled SVG %s", binaryPath.c_str ());
+            return false;
+        }
+
+        INFO ("Compiled SVG %s to %s", svgPath.c_str (), binaryPath.c_str ());
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rack_themer {
+    /*
+     * Compiled SVGs hold a ThemeableSvg's flattened tables, including the windings and level of detail tiers computed
+     * when it was loaded, so loading one doesn't parse or compute anything.
+     *
+     * The file is the header, the shape, path and gradient records, the points, the level of detail tiers and then
+     * the shapes' ids, all in native byte order. The header also records the size and hash of the SVG it was compiled
+     * from, so it can be told apart from an outdated binary. Loading one validates the whole file, then copies each
+     * table into the new ThemeableSvg with one allocation per table. The records are never used in place.
+     */
+    struct SvgBinary {
+        static constexpr uint32_t FormatVersion = 2;
+
+        static std::vector<uint8_t> serialize (const ThemeableSvg& svg, uint64_t sourceHash = 0, size_t sourceSize = 0);
+        // Returns null if the data isn't a valid compiled SVG of the current version.
+        static std::shared_ptr<ThemeableSvg> deserialize (const uint8_t* data, size_t size);
+        // Reads the size and hash of the SVG the data was compiled from. Returns false if it's invalid or they're unknown.
+        static bool getSource (const uint8_t* data, size_t size, uint64_t& sourceHash, size_t& sourceSize);
+
+        static bool save (const ThemeableSvg& svg, const std::string& path, uint64_t sourceHash = 0, size_t sourceSize = 0);
+        // Parses the SVG and saves its compiled binary, without going through the cache.
+        static bool compile (const std::string& svgPath, const std::string& binaryPath);
+    };
+}
\ No newline at end of file
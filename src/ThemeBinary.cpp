@@ -0,0 +1,379 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThemeBinary.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "ThemeLoader.hpp"
+
+#include <cstdio>
+#include <unordered_map>
+
+namespace rack_themer {
+    static constexpr uint32_t BinaryMagic = 0x48545452; // "RTTH"
+    // Written as a number, so files from a machine with the other byte order are rejected.
+    static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+    // Style flags
+    static constexpr uint32_t StyleHasOpacity = 1 << 0;
+    static constexpr uint32_t StyleHasStrokeWidth = 1 << 1;
+    static constexpr uint32_t StyleHasStrokeLineCap = 1 << 2;
+    static constexpr uint32_t StyleHasStrokeLineJoin = 1 << 3;
+
+    struct BinaryString {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t byteOrder;
+        // The size and hash of the file it was compiled from, or zero if unknown.
+        uint32_t sourceSize;
+        uint64_t sourceHash;
+
+        BinaryString name;
+        uint32_t numStyles;
+        uint32_t numClassEntries;
+        uint32_t numIdEntries;
+        uint32_t numStringBytes;
+    };
+
+    struct BinaryGradientStop {
+        int32_t index;
+        float offset;
+        float color [4];
+    };
+
+    struct BinaryPaint {
+        // A PaintKind.
+        uint32_t kind;
+        float color [4];
+        int32_t numStops;
+        BinaryGradientStop stops [2];
+    };
+
+    struct BinaryStyle {
+        BinaryPaint fill;
+        BinaryPaint stroke;
+
+        uint32_t flags;
+        float opacity;
+        float strokeWidth;
+        int32_t strokeLineCap;
+        int32_t strokeLineJoin;
+    };
+
+    struct BinaryEntry {
+        BinaryString name;
+        uint32_t style;
+    };
+
+    static_assert (sizeof (BinaryHeader) % 4 == 0 && sizeof (BinaryStyle) % 4 == 0 && sizeof (BinaryEntry) % 4 == 0,
+                   "Compiled theme records must keep the tables after them 4 byte aligned");
+
+    struct BinaryLayout {
+        size_t styles, classEntries, idEntries, strings, size;
+
+        BinaryLayout (const BinaryHeader& header) {
+            styles = sizeof (BinaryHeader);
+            classEntries = styles + header.numStyles * sizeof (BinaryStyle);
+            idEntries = classEntries + header.numClassEntries * sizeof (BinaryEntry);
+            strings = idEntries + header.numIdEntries * sizeof (BinaryEntry);
+            size = strings + header.numStringBytes;
+        }
+    };
+
+    static void toBinary (float binaryColor [4], NVGcolor color) {
+        binaryColor [0] = color.r;
+        binaryColor [1] = color.g;
+        binaryColor [2] = color.b;
+        binaryColor [3] = color.a;
+    }
+
+    static NVGcolor fromBinary (const float binaryColor [4]) {
+        return nvgRGBAf (binaryColor [0], binaryColor [1], binaryColor [2], binaryColor [3]);
+    }
+
+    static BinaryPaint toBinary (const Paint& paint) {
+        auto binaryPaint = BinaryPaint ();
+        binaryPaint.kind = static_cast<uint32_t> (paint.Kind ());
+
+        if (paint.isColor ())
+            toBinary (binaryPaint.color, paint.getColor ());
+
+        if (auto gradient = paint.getGradient (); gradient != nullptr) {
+            binaryPaint.numStops = gradient->nstops;
+            for (int i = 0; i < 2; i++) {
+                binaryPaint.stops [i].index = gradient->stops [i].index;
+                binaryPaint.stops [i].offset = gradient->stops [i].offset;
+                toBinary (binaryPaint.stops [i].color, gradient->stops [i].color);
+            }
+        }
+
+        return binaryPaint;
+    }
+
+    static Paint fromBinary (const BinaryPaint& binaryPaint) {
+        switch (static_cast<PaintKind> (binaryPaint.kind)) {
+            default:
+            case PaintKind::Unset:
+                return Paint::makeUnset ();
+
+            case PaintKind::None:
+                return Paint::makeNone ();
+
+            case PaintKind::Color:
+                return Paint::makeColor (fromBinary (binaryPaint.color));
+
+            case PaintKind::Gradient: {
+                auto gradient = Gradient ();
+                gradient.nstops = binaryPaint.numStops;
+                for (int i = 0; i < 2; i++) {
+                    const auto& stop = binaryPaint.stops [i];
+                    gradient.stops [i] = GradientStop (stop.index, stop.offset, fromBinary (stop.color));
+                }
+
+                return Paint::makeGradient (gradient);
+            }
+        }
+    }
+
+    static BinaryStyle toBinary (const Style& style) {
+        auto binaryStyle = BinaryStyle ();
+        binaryStyle.fill = toBinary (style.getFill ());
+        binaryStyle.stroke = toBinary (style.getStroke ());
+
+        binaryStyle.flags = (style.hasOpacity () ? StyleHasOpacity : 0) |
+                            (style.hasStrokeWidth () ? StyleHasStrokeWidth : 0) |
+                            (style.hasStrokeLineCap () ? StyleHasStrokeLineCap : 0) |
+                            (style.hasStrokeLineJoin () ? StyleHasStrokeLineJoin : 0);
+        binaryStyle.opacity = style.getOpacity ();
+        binaryStyle.strokeWidth = style.getStrokeWidth ();
+        binaryStyle.strokeLineCap = style.getStrokeLineCap ();
+        binaryStyle.strokeLineJoin = style.getStrokeLineJoin ();
+
+        return binaryStyle;
+    }
+
+    static Style fromBinary (const BinaryStyle& binaryStyle) {
+        auto style = Style ();
+        style.setFill (fromBinary (binaryStyle.fill));
+        style.setStroke (fromBinary (binaryStyle.stroke));
+
+        if (binaryStyle.flags & StyleHasOpacity)
+            style.setOpacity (binaryStyle.opacity);
+        if (binaryStyle.flags & StyleHasStrokeWidth)
+            style.setStrokeWidth (binaryStyle.strokeWidth);
+        if (binaryStyle.flags & StyleHasStrokeLineCap)
+            style.setStrokeLineCap (static_cast<NVGlineCap> (binaryStyle.strokeLineCap));
+        if (binaryStyle.flags & StyleHasStrokeLineJoin)
+            style.setStrokeLineJoin (binaryStyle.strokeLineJoin);
+
+        return style;
+    }
+
+    template<typename T>
+    static void append (std::vector<uint8_t>& data, const T* values, size_t count) {
+        auto bytes = reinterpret_cast<const uint8_t*> (values);
+        data.insert (data.end (), bytes, bytes + count * sizeof (T));
+    }
+
+    std::vector<uint8_t> ThemeBinary::serialize (const RackTheme& theme, uint64_t sourceHash, size_t sourceSize) {
+        std::string strings;
+        auto addString = [&] (std::string_view text) {
+            auto binaryString = BinaryString { static_cast<uint32_t> (strings.size ()), static_cast<uint32_t> (text.size ()) };
+            strings.append (text);
+            return binaryString;
+        };
+
+        // Styles shared between entries are only stored once.
+        std::vector<BinaryStyle> styles;
+        std::unordered_map<const Style*, uint32_t> styleIndices;
+        auto addEntries = [&] (const std::unordered_map<KeyedString, std::shared_ptr<Style>>& map) {
+            std::vector<BinaryEntry> entries;
+            entries.reserve (map.size ());
+
+            for (const auto& [name, style] : map) {
+                if (style == nullptr)
+                    continue;
+
+                auto [found, inserted] = styleIndices.emplace (style.get (), static_cast<uint32_t> (styles.size ()));
+                if (inserted)
+                    styles.push_back (toBinary (*style));
+
+                entries.push_back ({ addString (getKeyedStringText (name)), found->second });
+            }
+
+            return entries;
+        };
+
+        auto header = BinaryHeader ();
+        header.magic = BinaryMagic;
+        header.version = FormatVersion;
+        header.byteOrder = ByteOrderMark;
+        header.sourceSize = static_cast<uint32_t> (sourceSize);
+        header.sourceHash = sourceHash;
+        header.name = addString (theme.name);
+
+        auto classEntries = addEntries (theme.classStyles);
+        auto idEntries = addEntries (theme.idStyles);
+
+        header.numStyles = static_cast<uint32_t> (styles.size ());
+        header.numClassEntries = static_cast<uint32_t> (classEntries.size ());
+        header.numIdEntries = static_cast<uint32_t> (idEntries.size ());
+        header.numStringBytes = static_cast<uint32_t> (strings.size ());
+
+        std::vector<uint8_t> data;
+        data.reserve (BinaryLayout (header).size);
+        append (data, &header, 1);
+        append (data, styles.data (), styles.size ());
+        append (data, classEntries.data (), classEntries.size ());
+        append (data, idEntries.data (), idEntries.size ());
+        append (data, strings.data (), strings.size ());
+
+        return data;
+    }
+
+    static bool isValidString (const BinaryString& string, const BinaryHeader& header) {
+        return string.offset <= header.numStringBytes && string.length <= header.numStringBytes - string.offset;
+    }
+
+    static bool isValidPaint (const BinaryPaint& paint) {
+        if (paint.kind > static_cast<uint32_t> (PaintKind::None))
+            return false;
+
+        // Gradient only has room for two stops, and drawing one needs at least one.
+        if (paint.kind == static_cast<uint32_t> (PaintKind::Gradient))
+            return paint.numStops >= 1 && paint.numStops <= 2;
+
+        return paint.numStops >= 0 && paint.numStops <= 2;
+    }
+
+    static bool isValidEntries (const BinaryEntry* entries, uint32_t count, const BinaryHeader& header) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!isValidString (entries [i].name, header) || entries [i].style >= header.numStyles)
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool isValid (const uint8_t* data, size_t size) {
+        if (size < sizeof (BinaryHeader))
+            return false;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        if (header.magic != BinaryMagic || header.version != ThemeBinary::FormatVersion || header.byteOrder != ByteOrderMark)
+            return false;
+
+        auto layout = BinaryLayout (header);
+        if (layout.size != size || !isValidString (header.name, header))
+            return false;
+
+        auto styles = reinterpret_cast<const BinaryStyle*> (data + layout.styles);
+        for (uint32_t i = 0; i < header.numStyles; i++) {
+            if (!isValidPaint (styles [i].fill) || !isValidPaint (styles [i].stroke))
+                return false;
+        }
+
+        return isValidEntries (reinterpret_cast<const BinaryEntry*> (data + layout.classEntries), header.numClassEntries, header) &&
+               isValidEntries (reinterpret_cast<const BinaryEntry*> (data + layout.idEntries), header.numIdEntries, header);
+    }
+
+    bool ThemeBinary::getSource (const uint8_t* data, size_t size, uint64_t& sourceHash, size_t& sourceSize) {
+        if (!isValid (data, size))
+            return false;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        sourceHash = header.sourceHash;
+        sourceSize = header.sourceSize;
+        return sourceHash != 0 || sourceSize != 0;
+    }
+
+    std::shared_ptr<RackTheme> ThemeBinary::deserialize (const uint8_t* data, size_t size) {
+        if (!isValid (data, size))
+            return nullptr;
+
+        const auto& header = *reinterpret_cast<const BinaryHeader*> (data);
+        auto layout = BinaryLayout (header);
+        auto binaryStyles = reinterpret_cast<const BinaryStyle*> (data + layout.styles);
+        auto strings = reinterpret_cast<const char*> (data + layout.strings);
+
+        auto getString = [&] (const BinaryString& string) { return std::string_view (strings + string.offset, string.length); };
+
+        auto theme = std::make_shared<RackTheme> ();
+        theme->name = getString (header.name);
+
+        // Every style lives in one block, and the entries point into it with aliasing pointers that share its
+        // ownership, instead of each style being allocated on its own.
+        auto styles = std::make_shared<std::vector<Style>> ();
+        styles->reserve (header.numStyles);
+        for (uint32_t i = 0; i < header.numStyles; i++)
+            styles->push_back (fromBinary (binaryStyles [i]));
+
+        auto addEntries = [&] (std::unordered_map<KeyedString, std::shared_ptr<Style>>& map, size_t offset, uint32_t count) {
+            auto entries = reinterpret_cast<const BinaryEntry*> (data + offset);
+            map.reserve (count);
+
+            for (uint32_t i = 0; i < count; i++)
+                map [getKeyedString (getString (entries [i].name))] = std::shared_ptr<Style> (styles, &(*styles) [entries [i].style]);
+        };
+
+        addEntries (theme->classStyles, layout.classEntries, header.numClassEntries);
+        addEntries (theme->idStyles, layout.idEntries, header.numIdEntries);
+
+        return theme;
+    }
+
+    bool ThemeBinary::save (const RackTheme& theme, const std::string& path, uint64_t sourceHash, size_t sourceSize) {
+        auto data = serialize (theme, sourceHash, sourceSize);
+
+        auto file = std::fopen (path.c_str (), "wb");
+        if (file == nullptr)
+            return false;
+
+        auto written = std::fwrite (data.data (), 1, data.size (), file);
+        // A partially written file fails the size check when it's loaded.
+        auto closed = std::fclose (file) == 0;
+
+        return closed && written == data.size ();
+    }
+
+    bool ThemeBinary::compile (const std::string& themePath, const std::string& binaryPath) {
+        std::vector<char> data;
+        if (!readFile (themePath, data)) {
+            WARN ("Failed to read theme %s", themePath.c_str ());
+            return false;
+        }
+
+        auto sourceSize = data.size () - 1;
+        auto theme = themeLoader.loadTheme (data.data (), sourceSize);
+        if (theme == nullptr)
+            return false;
+
+        if (!save (*theme, binaryPath, hashBytes (data.data (), sourceSize), sourceSize)) {
+            WARN ("Failed to write compiled theme %s", binaryPath.c_str ());
+            return false;
+        }
+
+        INFO ("Compiled theme %s to %s", themePath.c_str (), binaryPath.c_str ());
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rack_themer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rack_themer {
+    /*
+     * Compiled themes hold a parsed RackTheme: its name, a table of its distinct styles, and the id and class
+     * indices into that table, followed by the strings they refer to. Like compiled SVGs, everything is in native
+     * byte order, and the header records the size and hash of the JSON it was compiled from.
+     */
+    struct ThemeBinary {
+        static constexpr uint32_t FormatVersion = 2;
+
+        static std::vector<uint8_t> serialize (const RackTheme& theme, uint64_t sourceHash = 0, size_t sourceSize = 0);
+        // Returns null if the data isn't a valid compiled theme of the current version.
+        static std::shared_ptr<RackTheme> deserialize (const uint8_t* data, size_t size);
+        // Reads the size and hash of the JSON the data was compiled from. Returns false if it's invalid or they're unknown.
+        static bool getSource (const uint8_t* data, size_t size, uint64_t& sourceHash, size_t& sourceSize);
+
+        static bool save (const RackTheme& theme, const std::string& path, uint64_t sourceHash = 0, size_t sourceSize = 0);
+        // Parses the theme's JSON and saves its compiled binary, without going through the cache.
+        static bool compile (const std::string& themePath, const std::string& binaryPath);
+    };
+}
\ No newline at end of file
@@ -17,30 +17,87 @@
  */
 
 #include "ThemeCache.hpp"
+#include "DrawProgram.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "ParseCache.hpp"
 #include "rack_themer.hpp"
+#include "SvgBinary.hpp"
+#include "ThemeBinary.hpp"
 #include "ThemeLoader.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
 
 namespace rack_themer {
+    // Defined before the cache and the worker pool, so it outlives every job that might use it.
+    ParseCache parseCache;
     ThemeCache themeCache = ThemeCache ();
+    // Defined after the cache so it's destroyed first, and no job can outlive the cache.
+    WorkerPool workerPool;
+
+    template<typename T>
+    static std::shared_future<T> makeReadyFuture (T value) {
+        auto promise = std::promise<T> ();
+        promise.set_value (std::move (value));
+        return promise.get_future ().share ();
+    }
 
     std::shared_ptr<RackTheme> ThemeCache::createRackTheme (const std::string& path) {
-        if (path.empty ()) {
-            auto nullTheme = std::make_shared<RackTheme> ();
-            themeCache [path] = nullTheme;
-            return nullTheme;
+        if (path.empty ())
+            return std::make_shared<RackTheme> ();
+
+        std::vector<char> data;
+        auto hasSource = readFile (path, data);
+        auto size = hasSource ? data.size () - 1 : 0;
+        auto hash = hasSource ? hashBytes (data.data (), size) : 0;
+
+        // The compiled binary is used if it was compiled from the theme as it is now, or if it was shipped without it.
+        auto compiledPath = getCompiledThemePath (path);
+        auto file = MappedFile ();
+        if (file.open (compiledPath)) {
+            auto sourceHash = uint64_t (0);
+            auto sourceSize = size_t (0);
+            auto isCurrent = !hasSource || (ThemeBinary::getSource (file.getData (), file.getSize (), sourceHash, sourceSize) &&
+                                            sourceHash == hash && sourceSize == size);
+
+            if (auto theme = isCurrent ? ThemeBinary::deserialize (file.getData (), file.getSize ()) : nullptr; theme != nullptr) {
+                INFO ("Loaded compiled theme %s", path.c_str ());
+                return theme;
+            }
+
+            WARN ("Compiled theme %s is invalid or outdated, parsing the theme instead", compiledPath.c_str ());
         }
 
-        auto theme = themeLoader.loadTheme (path);
-        if (theme == nullptr)
-            return nullptr;
+        if (!hasSource)
+            return themeLoader.loadTheme (path);
 
-        themeCache [path] = theme;
+        // Themes parsed on an earlier launch are loaded from the parse cache, unless the file has changed since.
+        if (auto theme = parseCache.loadTheme (hash, size); theme != nullptr) {
+            INFO ("Loaded theme %s from the parse cache", path.c_str ());
+            return theme;
+        }
+
+        auto theme = themeLoader.loadTheme (data.data (), size);
+        if (theme != nullptr)
+            parseCache.storeTheme (hash, size, *theme);
 
         return theme;
     }
 
-    std::shared_ptr<ThemeableSvg> ThemeCache::createThemeableSvg (const std::string& path) {
-        auto handle = nsvgParseFromFile (path.c_str (), "px", rack::window::SVG_DPI);
+    std::shared_ptr<ThemeableSvg> ThemeCache::createThemeableSvg (const std::string& path, std::vector<char>& data, uint64_t hash, bool useParseCache) {
+        // SVGs parsed on an earlier launch are loaded from the parse cache, unless the file has changed since.
+        auto size = data.size () - 1;
+        if (auto svg = useParseCache ? parseCache.loadSvg (hash, size) : nullptr; svg != nullptr) {
+            INFO ("Loaded SVG %s from the parse cache", path.c_str ());
+            svg->path = path;
+            return svg;
+        }
+
+        // NanoSVG parses the text in place.
+        auto handle = nsvgParse (data.data (), "px", rack::window::SVG_DPI);
         if (handle == nullptr) {
             WARN ("Failed to load SVG %s", path.c_str ());
             return nullptr;
@@ -50,61 +107,481 @@ namespace rack_themer {
 
         auto svg = std::make_shared<ThemeableSvg> ();
         svg->handle = handle;
-        svgCache [path] = svg;
+        svg->path = path;
+        svg->buildGeometry ();
+
+        if (useParseCache)
+            parseCache.storeSvg (hash, size, *svg);
+
+        return svg;
+    }
 
+    std::shared_ptr<ThemeableSvg> ThemeCache::createCompiledSvg (const std::string& path, const uint8_t* data, size_t size) {
+        auto svg = SvgBinary::deserialize (data, size);
+        if (svg == nullptr)
+            return nullptr;
+
+        INFO ("Loaded compiled SVG %s", path.c_str ());
+
+        svg->path = path;
         return svg;
     }
 
     std::shared_ptr<RackTheme> ThemeCache::getRackTheme (const std::string& path) {
-        if (auto themeSearch = themeCache.find (path); themeSearch != themeCache.end ())
-            return themeSearch->second;
+        // Failed loads aren't stored, so they're retried the next time.
+        return themeCache.getOrCreate (path, [&] (std::shared_ptr<RackTheme>& theme) {
+            theme = createRackTheme (path);
+            return theme != nullptr;
+        });
+    }
+
+    std::shared_ptr<ThemeableSvg> ThemeCache::findSvg (const std::string& path, uint64_t& hash) {
+        auto svg = std::shared_ptr<ThemeableSvg> ();
+        if (svgPaths.find (path, hash))
+            svgCache.find (hash, svg);
+
+        return svg;
+    }
+
+    bool ThemeCache::isSameSource (const ThemeableSvg& svg, size_t size, const std::vector<char>* text) {
+        if (svg.sourceSize != size)
+            return false;
+        if (text == nullptr)
+            return true;
+
+        // SVGs whose file can't be read anymore can't be compared, so they're assumed to match.
+        std::vector<char> svgText;
+        if (!readFile (svg.path, svgText))
+            return true;
+
+        return svgText.size () == text->size () && std::memcmp (svgText.data (), text->data (), text->size ()) == 0;
+    }
+
+    std::shared_ptr<ThemeableSvg> ThemeCache::loadSvgFile (const std::string& path) {
+        // Other spellings of the same path are only resolved on a miss, since it has to ask the file system.
+        auto canonicalPath = rack::system::getCanonical (path);
+        auto hash = uint64_t (0);
+        auto svg = findSvg (canonicalPath, hash);
+        if (svg != nullptr) {
+            svgPaths.set (path, hash);
+            numSvgPathHits++;
+            return svg;
+        }
+
+        auto created = false;
+        auto sourceSize = size_t (0);
+        auto getOrCreate = [&] (auto&& create) {
+            return svgCache.getOrCreate (hash, [&] (std::shared_ptr<ThemeableSvg>& svg) {
+                svg = create ();
+                created = svg != nullptr;
+                if (created)
+                    svg->sourceSize = sourceSize;
+
+                return created;
+            });
+        };
 
-        return createRackTheme (path);
+        std::vector<char> data;
+        auto hasSource = readFile (canonicalPath, data);
+        auto size = hasSource ? data.size () - 1 : 0;
+        auto sourceHash = hasSource ? hashBytes (data.data (), size) : 0;
+
+        // The compiled binary is used if it was compiled from the SVG as it is now, or if it was shipped without it.
+        auto compiledPath = getCompiledSvgPath (canonicalPath);
+        auto file = MappedFile ();
+        if (file.open (compiledPath)) {
+            auto binarySourceHash = uint64_t (0);
+            auto binarySourceSize = size_t (0);
+            auto hasBinarySource = SvgBinary::getSource (file.getData (), file.getSize (), binarySourceHash, binarySourceSize);
+            auto isCurrent = !hasSource || (hasBinarySource && binarySourceHash == sourceHash && binarySourceSize == size);
+
+            if (isCurrent) {
+                // Stored under the hash of the SVG it was compiled from, so it's shared with copies of that SVG loaded
+                // from their text. Binaries that don't record their source can only be shared with identical binaries.
+                hash = hasBinarySource ? binarySourceHash : hashBytes (file.getData (), file.getSize ());
+                sourceSize = hasBinarySource ? binarySourceSize : file.getSize ();
+                svg = getOrCreate ([&] { return createCompiledSvg (canonicalPath, file.getData (), file.getSize ()); });
+            }
+
+            if (svg == nullptr)
+                WARN ("Compiled SVG %s is invalid or outdated, parsing the SVG instead", compiledPath.c_str ());
+        }
+
+        if (svg == nullptr) {
+            if (!hasSource) {
+                WARN ("Failed to read SVG %s", path.c_str ());
+                return nullptr;
+            }
+
+            hash = sourceHash;
+            sourceSize = size;
+            svg = getOrCreate ([&] { return createThemeableSvg (canonicalPath, data, hash); });
+        }
+
+        if (svg == nullptr)
+            return nullptr;
+
+        // Another SVG whose hash collides with this one's is kept out of the cache, and its paths aren't recorded, so
+        // the SVG already stored under that hash stays where it is. The parse cache can't tell them apart either.
+        if (!created && !isSameSource (*svg, sourceSize, hasSource ? &data : nullptr)) {
+            WARN ("SVG %s has the same hash as %s, but different contents, loading it separately", path.c_str (), svg->path.c_str ());
+            return hasSource
+                ? createThemeableSvg (canonicalPath, data, sourceHash, false)
+                : createCompiledSvg (canonicalPath, file.getData (), file.getSize ());
+        }
+
+        svgPaths.set (canonicalPath, hash);
+        svgPaths.set (path, hash);
+
+        if (created) {
+            numSvgsParsed++;
+            // The new SVG is held by the caller, so it can't be evicted itself.
+            evictOverBudget ();
+        } else {
+            numSvgsDeduplicated++;
+            INFO ("SVG %s is identical to %s, sharing it", path.c_str (), svg->path.c_str ());
+        }
+
+        return svg;
     }
 
     std::shared_ptr<ThemeableSvg> ThemeCache::getSvg (const std::string& path) {
-        if (auto svgSearch = svgCache.find (path); svgSearch != svgCache.end ())
-            return svgSearch->second;
+        auto hash = uint64_t (0);
+        auto svg = findSvg (path, hash);
+        if (svg != nullptr)
+            numSvgPathHits++;
+        else
+            svg = loadSvgFile (path);
 
-        return createThemeableSvg (path);
+        if (svg == nullptr)
+            return nullptr;
+
+        svg->lastAccess = ++accessTick;
+        return svg;
     }
 
-    ShapeInfo ThemeCache::getShapeInfo (const NSVGshape* shape) {
-        if (shape == nullptr)
-            return ShapeInfo ();
+    std::shared_future<std::shared_ptr<RackTheme>> ThemeCache::getRackThemeAsync (const std::string& path) {
+        auto theme = std::shared_ptr<RackTheme> ();
+        if (themeCache.find (path, theme))
+            return makeReadyFuture (theme);
 
-        if (auto infoSearch = shapeInfoMap.find (shape); infoSearch != shapeInfoMap.end ())
-            return infoSearch->second;
+        return workerPool.submit ([this, path] { return getRackTheme (path); }).share ();
+    }
 
-        auto id = std::string (shape->id);
-        auto dashes = id.rfind ("--");
+    SvgFuture ThemeCache::getSvgAsync (const std::string& path) {
+        auto hash = uint64_t (0);
+        auto svg = findSvg (path, hash);
+        if (svg != nullptr)
+            return makeReadyFuture (svg);
 
-        auto shapeId = dashes != std::string::npos ? id.substr (0, dashes) : id;
-        auto styleClass = dashes != std::string::npos ? id.substr (dashes + 2) : "";
+        return workerPool.submit ([this, path] {
+            auto svg = getSvg (path);
 
-        ShapeInfo info;
-        info.shapeId = getKeyedString (shapeId);
-        info.styleClass = getKeyedString (styleClass);
+            // Compile it for the loaded themes while we're off the UI thread, so the first draw doesn't have to.
+            if (svg != nullptr)
+                createDrawPrograms (*svg);
 
-        shapeInfoMap [shape] = info;
-        return info;
+            return svg;
+        }).share ();
     }
 
-    KeyedString ThemeCache::getKeyedString (const std::string& text) {
-        if (auto keySearch = stringCache.find (text); keySearch != stringCache.end ())
-            return keySearch->second;
+    template<typename TLoad>
+    static PreloadTiming timePreload (const std::string& path, bool isTheme, TLoad&& load) {
+        auto timing = PreloadTiming ();
+        timing.path = path;
+        timing.isTheme = isTheme;
 
-        KeyedString key;
-        key.value = nextStringKeyValue++;
-        stringCache [text] = key;
-        keyStringMap [key] = text;
-        return key;
+        auto start = rack::system::getNanoseconds ();
+        timing.loaded = load ();
+        timing.milliseconds = (rack::system::getNanoseconds () - start) / 1e6;
+
+        return timing;
     }
 
-    std::string ThemeCache::getKeyedStringText (const KeyedString& key) {
-        if (auto stringSearch = keyStringMap.find (key); stringSearch != keyStringMap.end ())
-            return stringSearch->second;
+    PreloadResult ThemeCache::preload (const PreloadManifest& manifest) {
+        auto start = rack::system::getNanoseconds ();
+        auto result = PreloadResult ();
+
+        auto waitForJobs = [&] (std::vector<std::future<PreloadTiming>>& jobs, const std::vector<std::string>& paths, bool isTheme) {
+            for (size_t i = 0; i < jobs.size (); i++) {
+                // Jobs dropped by a shutdown count as failed.
+                auto dropped = PreloadTiming ();
+                dropped.path = paths [i];
+                dropped.isTheme = isTheme;
+
+                auto timing = getJobResult (jobs [i], dropped);
+                (timing.loaded ? result.numLoaded : result.numFailed)++;
+                result.timings.push_back (std::move (timing));
+            }
+        };
+
+        // Themes go first, so the SVGs can be compiled for all of them.
+        std::vector<std::future<PreloadTiming>> themeJobs;
+        for (const auto& path : manifest.themePaths) {
+            themeJobs.push_back (workerPool.submit ([this, path] {
+                return timePreload (path, true, [&] { return getRackTheme (path) != nullptr; });
+            }));
+        }
+        waitForJobs (themeJobs, manifest.themePaths, true);
+
+        std::vector<std::future<PreloadTiming>> svgJobs;
+        for (const auto& path : manifest.svgPaths) {
+            svgJobs.push_back (workerPool.submit ([this, path] {
+                return timePreload (path, false, [&] {
+                    auto svg = getSvg (path);
+                    if (svg == nullptr)
+                        return false;
+
+                    createDrawPrograms (*svg);
+                    return true;
+                });
+            }));
+        }
+        waitForJobs (svgJobs, manifest.svgPaths, false);
+
+        result.milliseconds = (rack::system::getNanoseconds () - start) / 1e6;
+        INFO ("Preloaded %d assets in %.1f ms, %d failed", result.numLoaded, result.milliseconds, result.numFailed);
+
+        return result;
+    }
 
-        return nullptr;
+    std::shared_ptr<DrawProgram> ThemeCache::createDrawProgram (const ThemeableSvg& svg, const RackTheme* theme) {
+        return drawProgramCache.getOrCreate (ThemedSvgKey (svg, theme), [&] (std::shared_ptr<DrawProgram>& program) {
+            auto styles = getResolvedStyles (svg, theme);
+            program = DrawProgram::compile (svg, theme, *styles);
+            return true;
+        });
+    }
+
+    std::shared_ptr<const std::vector<Style>> ThemeCache::getResolvedStyles (const ThemeableSvg& svg, const RackTheme* theme) {
+        return resolvedStylesCache.getOrCreate (ThemedSvgKey (svg, theme), [&] (std::shared_ptr<const std::vector<Style>>& styles) {
+            styles = std::make_shared<const std::vector<Style>> (DrawProgram::resolveStyles (svg, theme));
+            return true;
+        });
+    }
+
+    std::shared_ptr<DrawProgram> ThemeCache::getDrawProgram (const ThemeableSvg& svg, const RackTheme* theme) {
+        auto program = std::shared_ptr<DrawProgram> ();
+        if (drawProgramCache.find (ThemedSvgKey (svg, theme), program))
+            return program;
+
+        program = createDrawProgram (svg, theme);
+
+        // Also compile the SVG for every other theme that's loaded, so switching to one of them later only has to
+        // swap the program pointer. That's done in the background, so the draw asking for this one isn't held up.
+        // SVGs that aren't owned by a shared_ptr can't be kept alive until then, so they're only compiled on demand.
+        if (auto svgRef = svg.weak_from_this ().lock (); svgRef != nullptr)
+            workerPool.submit ([this, svgRef] { createDrawPrograms (*svgRef); });
+
+        return program;
+    }
+
+    void ThemeCache::createDrawPrograms (const ThemeableSvg& svg) {
+        // The themes are collected first, so no lock on the theme table is held while compiling. Holding references
+        // keeps them alive if they're evicted in the meantime.
+        std::vector<std::shared_ptr<RackTheme>> themes;
+        themeCache.forEach ([&] (const std::string& path, const std::shared_ptr<RackTheme>& theme) {
+            if (theme != nullptr)
+                themes.push_back (theme);
+        });
+
+        for (const auto& theme : themes)
+            createDrawProgram (svg, theme.get ());
+    }
+
+    /*
+     * Eviction
+     */
+    void ThemeCache::setSvgMemoryBudget (size_t bytes) {
+        svgMemoryBudget = bytes;
+        evictOverBudget ();
+    }
+
+    std::unordered_map<uint64_t, size_t> ThemeCache::getProgramMemoryUsage () {
+        std::unordered_map<uint64_t, size_t> usage;
+        drawProgramCache.forEach ([&] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) {
+            usage [key.svgId] += program->getMemoryUsage ();
+        });
+
+        return usage;
+    }
+
+    size_t ThemeCache::getSvgMemoryUsage () {
+        auto usage = size_t (0);
+        svgCache.forEach ([&] (uint64_t hash, const std::shared_ptr<ThemeableSvg>& svg) { usage += svg->getMemoryUsage (); });
+        for (const auto& [svgId, programUsage] : getProgramMemoryUsage ())
+            usage += programUsage;
+
+        return usage;
+    }
+
+    SvgCacheStats ThemeCache::getSvgCacheStats () {
+        auto stats = SvgCacheStats ();
+        stats.numPathHits = numSvgPathHits;
+        stats.numDeduplicated = numSvgsDeduplicated;
+        stats.numParsed = numSvgsParsed;
+        return stats;
+    }
+
+    bool ThemeCache::evictSvg (uint64_t hash, const ThemeableSvg* svgPtr) {
+        // Only evict it if the cache holds the only reference. Checking under the write lock means nobody can look it
+        // up in the meantime. It's kept alive until everything derived from it has been purged too.
+        auto evicted = std::shared_ptr<ThemeableSvg> ();
+        auto erased = svgCache.eraseIf (hash, [&] (const std::shared_ptr<ThemeableSvg>& svg) {
+            if (svg.get () != svgPtr || svg.use_count () != 1)
+                return false;
+
+            evicted = svg;
+            return true;
+        });
+
+        if (!erased)
+            return false;
+
+        auto svgId = evicted->getUniqueId ();
+        svgPaths.eraseWhere ([&] (const std::string& path, uint64_t pathHash) { return pathHash == hash; });
+        drawProgramCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) { return key.svgId == svgId; });
+        resolvedStylesCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<const std::vector<Style>>& styles) { return key.svgId == svgId; });
+
+        return true;
+    }
+
+    bool ThemeCache::evictTheme (const std::string& path, const RackTheme* themePtr) {
+        auto evicted = std::shared_ptr<RackTheme> ();
+        auto erased = themeCache.eraseIf (path, [&] (const std::shared_ptr<RackTheme>& theme) {
+            if (theme.get () != themePtr || theme.use_count () != 1)
+                return false;
+
+            evicted = theme;
+            return true;
+        });
+
+        if (!erased)
+            return false;
+
+        auto themeId = evicted->getUniqueId ();
+        drawProgramCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) { return key.themeId == themeId; });
+        resolvedStylesCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<const std::vector<Style>>& styles) { return key.themeId == themeId; });
+
+        return true;
+    }
+
+    void ThemeCache::evictOverBudget () {
+        auto budget = svgMemoryBudget.load ();
+        if (budget == 0)
+            return;
+
+        std::unique_lock lock (evictionMutex);
+
+        auto programUsage = getProgramMemoryUsage ();
+        auto usage = size_t (0);
+
+        struct Candidate {
+            uint64_t hash;
+            const ThemeableSvg* svg;
+            uint64_t lastAccess;
+            size_t memoryUsage;
+        };
+
+        // Only SVGs nothing outside the cache holds can be evicted.
+        std::vector<Candidate> candidates;
+        svgCache.forEach ([&] (uint64_t hash, const std::shared_ptr<ThemeableSvg>& svg) {
+            auto svgUsage = svg->getMemoryUsage () + programUsage [svg->getUniqueId ()];
+            usage += svgUsage;
+
+            if (svg.use_count () == 1)
+                candidates.push_back ({ hash, svg.get (), svg->lastAccess, svgUsage });
+        });
+
+        if (usage <= budget)
+            return;
+
+        std::sort (candidates.begin (), candidates.end (), [] (const Candidate& lhs, const Candidate& rhs) { return lhs.lastAccess < rhs.lastAccess; });
+
+        for (const auto& candidate : candidates) {
+            if (usage <= budget)
+                break;
+
+            if (evictSvg (candidate.hash, candidate.svg))
+                usage -= candidate.memoryUsage;
+        }
+    }
+
+    void ThemeCache::purgeUnusedAssets () {
+        std::unique_lock lock (evictionMutex);
+
+        std::vector<std::pair<uint64_t, const ThemeableSvg*>> svgs;
+        svgCache.forEach ([&] (uint64_t hash, const std::shared_ptr<ThemeableSvg>& svg) {
+            if (svg.use_count () == 1)
+                svgs.push_back ({ hash, svg.get () });
+        });
+
+        for (const auto& [hash, svg] : svgs)
+            evictSvg (hash, svg);
+
+        std::vector<std::pair<std::string, const RackTheme*>> themes;
+        themeCache.forEach ([&] (const std::string& path, const std::shared_ptr<RackTheme>& theme) {
+            if (theme.use_count () == 1)
+                themes.push_back ({ path, theme.get () });
+        });
+
+        for (const auto& [path, theme] : themes)
+            evictTheme (path, theme);
+
+        // Programs compiled for themes that weren't loaded through the cache aren't evicted along with their theme,
+        // so they're dropped once nothing draws with them anymore.
+        std::unordered_set<uint64_t> cachedThemes = { 0 };
+        themeCache.forEach ([&] (const std::string& path, const std::shared_ptr<RackTheme>& theme) {
+            if (theme != nullptr)
+                cachedThemes.insert (theme->getUniqueId ());
+        });
+
+        drawProgramCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) {
+            return program.use_count () == 1 && cachedThemes.count (key.themeId) == 0;
+        });
+        resolvedStylesCache.eraseWhere ([&] (const ThemedSvgKey& key, const std::shared_ptr<const std::vector<Style>>& styles) {
+            return styles.use_count () == 1 && cachedThemes.count (key.themeId) == 0;
+        });
+    }
+
+    json_t* ThemeCache::getDrawStatsJson () {
+        // Programs only know their theme's id, so the names are looked up from the themes that are still loaded.
+        std::unordered_map<uint64_t, std::string> themeNames;
+        themeCache.forEach ([&] (const std::string& path, const std::shared_ptr<RackTheme>& theme) {
+            if (theme != nullptr)
+                themeNames [theme->getUniqueId ()] = theme->getName ();
+        });
+
+        auto svgsJ = json_object ();
+        svgCache.forEach ([&] (uint64_t hash, const std::shared_ptr<ThemeableSvg>& svg) {
+            auto themesJ = json_object ();
+            drawProgramCache.forEach ([&] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) {
+                if (key.svgId != svg->getUniqueId ())
+                    return;
+
+                auto themeName = themeNames [key.themeId];
+                json_object_set_new (themesJ, themeName.c_str (), program->getStats ().toJson ());
+            });
+
+            auto svgJ = svg->getStats ().toJson ();
+            json_object_set_new (svgJ, "themes", themesJ);
+            json_object_set_new (svgsJ, svg->path.c_str (), svgJ);
+        });
+
+        auto rootJ = json_object ();
+        json_object_set_new (rootJ, "enabled", json_boolean (isDrawStatsEnabled ()));
+        json_object_set_new (rootJ, "svgs", svgsJ);
+        return rootJ;
+    }
+
+    void ThemeCache::resetDrawStats () {
+        svgCache.forEach ([] (uint64_t hash, const std::shared_ptr<ThemeableSvg>& svg) { svg->resetStats (); });
+        drawProgramCache.forEach ([] (const ThemedSvgKey& key, const std::shared_ptr<DrawProgram>& program) { program->resetStats (); });
+    }
+
+    KeyedString ThemeCache::getKeyedString (std::string_view text) {
+        auto key = KeyedString ();
+        key.value = strings.intern (text);
+        return key;
     }
 }
\ No newline at end of file
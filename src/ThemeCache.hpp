@@ -19,41 +19,114 @@
 #pragma once
 
 #include "rack_themer.hpp"
+#include "ShardedMap.hpp"
+#include "StringInterner.hpp"
 
 #include <rack.hpp>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace rack_themer {
-    struct ShapeInfo {
-        KeyedString shapeId;
-        KeyedString styleClass;
+    struct DrawProgram;
+
+    // Keyed by the objects' unique ids rather than their addresses, which can be reused once they're freed.
+    struct ThemedSvgKey {
+        uint64_t svgId = 0;
+        // Zero for the null theme.
+        uint64_t themeId = 0;
+
+        ThemedSvgKey (const ThemeableSvg& svg, const RackTheme* theme)
+            : svgId (svg.getUniqueId ()), themeId (theme != nullptr ? theme->getUniqueId () : 0) { }
+
+        bool operator== (const ThemedSvgKey& rhs) const { return svgId == rhs.svgId && themeId == rhs.themeId; }
+        std::size_t getHash () const {
+            auto svgHash = std::hash<uint64_t> {} (svgId);
+            return svgHash ^ (std::hash<uint64_t> {} (themeId) + 0x9E3779B9 + (svgHash << 6) + (svgHash >> 2));
+        }
     };
+}
 
+template<>
+struct std::hash<rack_themer::ThemedSvgKey> {
+    std::size_t operator() (const rack_themer::ThemedSvgKey& k) const { return k.getHash (); }
+};
+
+namespace rack_themer {
+    /*
+     * Every table is a ShardedMap, so the cache can be used from any thread.
+     * Entries are created without holding any lock, so a slow load only delays callers asking for that same entry.
+     */
     struct ThemeCache {
       private:
-        std::unordered_map<std::string, std::shared_ptr<RackTheme>> themeCache = {};
-        std::unordered_map<std::string, std::shared_ptr<ThemeableSvg>> svgCache = {};
+        ShardedMap<std::string, std::shared_ptr<RackTheme>> themeCache;
+        // SVGs are stored by a hash of their text, so identical files reached through different paths share one
+        // ThemeableSvg. Compiled binaries use the hash of the SVG they were compiled from, so they're shared with it too.
+        // Both the requested and the canonical path of every loaded file map to its hash. The sizes and texts are compared
+        // when a file's hash is found, so a collision never shares the wrong SVG.
+        ShardedMap<std::string, uint64_t> svgPaths;
+        ShardedMap<uint64_t, std::shared_ptr<ThemeableSvg>> svgCache;
+
+        // Resolved styles and draw programs are shared by every widget drawing the same SVG with the same theme.
+        ShardedMap<ThemedSvgKey, std::shared_ptr<DrawProgram>> drawProgramCache;
+        ShardedMap<ThemedSvgKey, std::shared_ptr<const std::vector<Style>>> resolvedStylesCache;
 
-        std::unordered_map<const NSVGshape*, ShapeInfo> shapeInfoMap;
+        // Has its own lock, which is never held while waiting on any other.
+        StringInterner strings;
 
-        std::unordered_map<std::string, KeyedString> stringCache = {};
-        std::unordered_map<KeyedString, std::string> keyStringMap = {};
-        int nextStringKeyValue = 1;
+        std::atomic<uint64_t> numSvgPathHits = 0;
+        std::atomic<uint64_t> numSvgsDeduplicated = 0;
+        std::atomic<uint64_t> numSvgsParsed = 0;
+
+        std::atomic<size_t> svgMemoryBudget = 0;
+        std::atomic<uint64_t> accessTick = 0;
+        // Only one thread evicts at a time.
+        std::mutex evictionMutex;
 
         std::shared_ptr<RackTheme> createRackTheme (const std::string& path);
-        std::shared_ptr<ThemeableSvg> createThemeableSvg (const std::string& path);
+        std::shared_ptr<ThemeableSvg> createThemeableSvg (const std::string& path, std::vector<char>& data, uint64_t hash, bool useParseCache = true);
+        std::shared_ptr<ThemeableSvg> createCompiledSvg (const std::string& path, const uint8_t* data, size_t size);
+        std::shared_ptr<ThemeableSvg> findSvg (const std::string& path, uint64_t& hash);
+        // Checks that an SVG found by hash was loaded from contents of the same size, and the same text if given.
+        bool isSameSource (const ThemeableSvg& svg, size_t size, const std::vector<char>* text);
+        std::shared_ptr<ThemeableSvg> loadSvgFile (const std::string& path);
+        std::shared_ptr<DrawProgram> createDrawProgram (const ThemeableSvg& svg, const RackTheme* theme);
+        void createDrawPrograms (const ThemeableSvg& svg);
+
+        // The memory used by the draw programs of each SVG, by the SVG's unique id.
+        std::unordered_map<uint64_t, size_t> getProgramMemoryUsage ();
+        bool evictSvg (uint64_t hash, const ThemeableSvg* svg);
+        bool evictTheme (const std::string& path, const RackTheme* theme);
+        void evictOverBudget ();
 
       public:
         std::shared_ptr<RackTheme> getRackTheme (const std::string& path);
         std::shared_ptr<ThemeableSvg> getSvg (const std::string& path);
+        // Cached assets are returned as ready futures, everything else is loaded on the worker pool.
+        std::shared_future<std::shared_ptr<RackTheme>> getRackThemeAsync (const std::string& path);
+        SvgFuture getSvgAsync (const std::string& path);
+
+        PreloadResult preload (const PreloadManifest& manifest);
+
+        void setSvgMemoryBudget (size_t bytes);
+        size_t getSvgMemoryBudget () { return svgMemoryBudget; }
+        size_t getSvgMemoryUsage ();
+        SvgCacheStats getSvgCacheStats ();
+        void purgeUnusedAssets ();
+
+        std::shared_ptr<const std::vector<Style>> getResolvedStyles (const ThemeableSvg& svg, const RackTheme* theme);
+        std::shared_ptr<DrawProgram> getDrawProgram (const ThemeableSvg& svg, const RackTheme* theme);
 
-        ShapeInfo getShapeInfo (const NSVGshape* shape);
+        json_t* getDrawStatsJson ();
+        void resetDrawStats ();
 
-        KeyedString getKeyedString (const std::string& text);
-        std::string getKeyedStringText (const KeyedString& key);
+        KeyedString getKeyedString (std::string_view text);
+        std::string_view getKeyedStringText (const KeyedString& key) { return strings.getText (key.value); }
     };
 
     extern ThemeCache themeCache;
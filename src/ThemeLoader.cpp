@@ -22,6 +22,8 @@
 
 #include <fmt/format.h>
 
+#include <utility>
+
 namespace rack_themer {
     ThemeLoader themeLoader = ThemeLoader ();
 
@@ -288,6 +290,10 @@ namespace logging {
         if (!ok)
             return false;
 
+        // A lone stop is always stored first, so the first and last stops are stops [0] and stops [nstops - 1].
+        if (gradient.stops [0].index < 0 && gradient.stops [1].index >= 0)
+            std::swap (gradient.stops [0], gradient.stops [1]);
+
         int count = 0;
         if (gradient.stops [0].index >= 0) ++count;
         if (gradient.stops [1].index >= 0) ++count;
@@ -508,6 +514,17 @@ namespace logging {
 
         json_error_t error;
         auto root = json_loadf (file, 0, &error);
+        std::fclose (file);
+
+        return loadTheme (root, error);
+    }
+
+    std::shared_ptr<RackTheme> ThemeLoader::loadTheme (const char* json, size_t size) {
+        json_error_t error;
+        return loadTheme (json_loadb (json, size, 0, &error), error);
+    }
+
+    std::shared_ptr<RackTheme> ThemeLoader::loadTheme (json_t* root, const json_error_t& error) {
         if (root == nullptr) {
             logError (logging::ErrorCode::JsonParseFailed, fmt::format (FMT_STRING ("Parse error - {} {}:{} {}"),
                 error.source,
@@ -516,7 +533,6 @@ namespace logging {
                 error.text
             ));
 
-            std::fclose (file);
             return nullptr;
         }
 
@@ -525,7 +541,6 @@ namespace logging {
             theme = nullptr;
 
         json_decref (root);
-        std::fclose (file);
 
         return theme;
     }
@@ -39,6 +39,7 @@ namespace rack_themer {
         void setLogger (logging::LogCallback logger) { this->logger = logger; }
 
         std::shared_ptr<RackTheme> loadTheme (std::string filePath);
+        std::shared_ptr<RackTheme> loadTheme (const char* json, size_t size);
 
       private:
         void logInfo (std::string info) { logger (logging::Severity::Info, logging::ErrorCode::NoError, info); }
@@ -59,6 +60,8 @@ namespace rack_themer {
         bool parseOpacity (json_t* root, std::shared_ptr<Style>);
         bool parseStyle (const char* name, json_t* root, std::shared_ptr<RackTheme> theme);
         bool parseTheme (json_t* root, std::shared_ptr<RackTheme>& theme);
+        // Takes ownership of root, which is null if the JSON failed to load.
+        std::shared_ptr<RackTheme> loadTheme (json_t* root, const json_error_t& error);
     };
 
     extern ThemeLoader themeLoader;
@@ -18,102 +18,76 @@
  */
 
 #include "rack_themer.hpp"
+#include "DrawProgram.hpp"
+#include "SvgBinary.hpp"
 #include "ThemeCache.hpp"
 
+#include <algorithm>
+
 namespace rack_themer {
     std::shared_ptr<ThemeableSvg> loadSvg (const std::string& path) { return themeCache.getSvg (path); }
-    std::string getShapeId (const NSVGshape* shape) {
-        if (shape != nullptr)
-            return getKeyedStringText (themeCache.getShapeInfo (shape).shapeId);
-        else
-            return "";
-    }
-
-    rack::math::Vec ThemeableSvg::getSize () {
-        if (handle == nullptr)
-            return rack::math::Vec ();
+    SvgFuture loadSvgAsync (const std::string& path) { return themeCache.getSvgAsync (path); }
 
-        return rack::math::Vec (handle->width, handle->height);
+    std::string getCompiledSvgPath (const std::string& svgPath) {
+        auto extension = rack::system::getExtension (svgPath);
+        return svgPath.substr (0, svgPath.size () - extension.size ()) + ".svgb";
     }
 
-    int ThemeableSvg::getNumShapes () {
-        if (handle == nullptr)
-            return 0;
+    bool compileSvg (const std::string& svgPath) { return SvgBinary::compile (svgPath, getCompiledSvgPath (svgPath)); }
 
-        int count = 0;
-        for (auto shape = handle->shapes; shape != nullptr; shape = shape->next)
-            count++;
+    /** Splits a shape's id into its own id and its style class: "shapeId--styleClass". */
+    static void splitShapeId (const char* id, std::string_view& shapeId, std::string_view& styleClass) {
+        auto idString = std::string_view (id);
+        auto dashes = idString.rfind ("--");
 
-        return count;
+        shapeId = dashes != std::string_view::npos ? idString.substr (0, dashes) : idString;
+        styleClass = dashes != std::string_view::npos ? idString.substr (dashes + 2) : std::string_view ();
     }
 
-    int ThemeableSvg::getNumPaths () {
-        if (handle == nullptr)
-            return 0;
+    std::string_view getShapeId (const NSVGshape* shape) {
+        if (shape == nullptr)
+            return std::string_view ();
 
-        int count = 0;
-        for (auto shape = handle->shapes; shape != nullptr; shape = shape->next) {
-            for (auto path = shape->paths; path != nullptr; path = path->next)
-                count++;
-        }
-
-        return count;
+        std::string_view shapeId, styleClass;
+        splitShapeId (shape->id, shapeId, styleClass);
+        return shapeId;
     }
 
-    int ThemeableSvg::getNumPoints () {
-        if (handle == nullptr)
-            return 0;
+    void setSvgMemoryBudget (size_t bytes) { themeCache.setSvgMemoryBudget (bytes); }
+    size_t getSvgMemoryBudget () { return themeCache.getSvgMemoryBudget (); }
+    size_t getSvgMemoryUsage () { return themeCache.getSvgMemoryUsage (); }
+    SvgCacheStats getSvgCacheStats () { return themeCache.getSvgCacheStats (); }
+    void purgeUnusedAssets () { themeCache.purgeUnusedAssets (); }
 
-        int count = 0;
-        for (auto shape = handle->shapes; shape != nullptr; shape = shape->next) {
-            for (auto path = shape->paths; path != nullptr; path = path->next)
-                count += path->npts / 3;
-        }
-
-        return count;
+    ThemeableSvg::~ThemeableSvg () {
+        if (handle != nullptr)
+            nsvgDelete (handle);
     }
 
-    void ThemeableSvg::forEachShape (const std::function<void (NSVGshape*)>& callback) {
-        if (handle == nullptr)
-            return;
-
-        auto shapes = handle->shapes;
-        for (NSVGshape* shape = shapes; shape != nullptr; shape = shape->next)
-            callback (shape);
-    }
+    rack::math::Vec ThemeableSvg::getSize () { return size; }
+    int ThemeableSvg::getNumShapes () { return static_cast<int> (shapes.size ()); }
+    int ThemeableSvg::getNumPaths () { return numPaths; }
+    int ThemeableSvg::getNumPoints () { return numPoints; }
+    SvgMetrics ThemeableSvg::getMetrics () { return metrics; }
+
+    static SvgPaint getSvgPaint (const NSVGpaint& paint) {
+        auto svgPaint = SvgPaint ();
+        svgPaint.type = paint.type;
+        svgPaint.color = paint.color;
+
+        auto isGradient = paint.type == NSVG_PAINT_LINEAR_GRADIENT || paint.type == NSVG_PAINT_RADIAL_GRADIENT;
+        if (isGradient && paint.gradient != nullptr && paint.gradient->nstops > 0) {
+            svgPaint.numStops = paint.gradient->nstops;
+            svgPaint.firstStopColor = paint.gradient->stops [0].color;
+            svgPaint.lastStopColor = paint.gradient->stops [paint.gradient->nstops - 1].color;
+        }
 
-    static NVGcolor getNVGColor (uint32_t color) {
-        return nvgRGBA (
-            (color >> 0) & 0xff,
-            (color >> 8) & 0xff,
-            (color >> 16) & 0xff,
-            (color >> 24) & 0xff
-        );
+        return svgPaint;
     }
 
-    static NVGpaint getGradient (NVGcontext* vg, NSVGpaint* paint, const Paint& stylePaint) {
-        assert (paint != nullptr);
-        assert (paint->type == NSVG_PAINT_LINEAR_GRADIENT || paint->type == NSVG_PAINT_RADIAL_GRADIENT);
-        assert (stylePaint.isGradient ());
-
-        auto gradient = paint->gradient;
-        auto styleGradient = stylePaint.getGradient ();
-        assert (styleGradient->nstops >= 1);
-
-        float inverse [6];
-        nvgTransformInverse (inverse, gradient->xform);
-
-        auto innerCol = styleGradient->stops [0].color;
-        auto outerCol = styleGradient->stops [styleGradient->nstops - 1].color;
-
-        // Is it always the case that the gradient should be transformed from (0, 0) to (0, 1)?
-        rack::math::Vec s, e;
-        nvgTransformPoint (&s.x, &s.y, inverse, 0, 0);
-        nvgTransformPoint (&e.x, &e.y, inverse, 0, 1);
-
-        return paint->type == NSVG_PAINT_LINEAR_GRADIENT
-               ? nvgLinearGradient (vg, s.x, s.y, e.x, e.y, innerCol, outerCol)
-               : nvgRadialGradient (vg, s.x, s.y, 0.0, 160, innerCol, outerCol);
+    void ThemeableSvg::forEachShape (const std::function<void (NSVGshape*)>& callback) {
+        for (const auto& shape : shapes)
+            callback (shape.source);
     }
 
     /** Returns the parameterized value of the line p2--p3 where it intersects with p0--p1 */
@@ -130,182 +104,236 @@ namespace rack_themer {
         return -(d.x * b.y - d.y * b.x) / m;
     }
 
-    Paint getShapePaint (const NSVGpaint paint) {
-        switch (paint.type) {
-            case NSVG_PAINT_NONE:
-                return Paint::makeNone ();
+    static int addGradient (std::vector<SvgGradient>& gradients, const NSVGpaint& paint) {
+        if (paint.type != NSVG_PAINT_LINEAR_GRADIENT && paint.type != NSVG_PAINT_RADIAL_GRADIENT)
+            return -1;
+        if (paint.gradient == nullptr)
+            return -1;
 
-            case NSVG_PAINT_COLOR:
-                return Paint::makeColor (getNVGColor (paint.color));
+        // NanoSVG stores the transform from user space into gradient space, where linear gradients run from (0, 0)
+        // to (0, 1) and radial gradients are a unit circle around (0, 0).
+        float inverse [6];
+        nvgTransformInverse (inverse, paint.gradient->xform);
 
-            case NSVG_PAINT_LINEAR_GRADIENT:
-            case NSVG_PAINT_RADIAL_GRADIENT: {
-                auto gradient = paint.gradient;
-                auto styleGradient = Gradient ();
+        auto& gradient = gradients.emplace_back ();
+        gradient.radial = paint.type == NSVG_PAINT_RADIAL_GRADIENT;
+        nvgTransformPoint (&gradient.start.x, &gradient.start.y, inverse, 0, 0);
+        nvgTransformPoint (&gradient.end.x, &gradient.end.y, inverse, 0, 1);
 
-                styleGradient.nstops = gradient->nstops;
-                styleGradient.stops [0].color = getNVGColor (gradient->stops [0].color);
-                styleGradient.stops [gradient->nstops - 1].color = getNVGColor (
-                    gradient->stops [gradient->nstops - 1].color
-                );
+        if (gradient.radial) {
+            rack::math::Vec edge;
+            nvgTransformPoint (&edge.x, &edge.y, inverse, 1, 0);
+            gradient.radius = (edge.minus (gradient.start).norm () + gradient.end.minus (gradient.start).norm ()) / 2.f;
+        }
 
-                return Paint::makeGradient (styleGradient);
-            }
+        return static_cast<int> (gradients.size ()) - 1;
+    }
+
+    /** Returns how far the control points of a cubic Bezier stray from the line between its end points. */
+    static float getCurveDeviation (const float* p) {
+        auto p0 = rack::math::Vec (p [0], p [1]);
+        auto p3 = rack::math::Vec (p [6], p [7]);
+        auto chord = p3.minus (p0);
+        auto length = chord.norm ();
+
+        auto deviation = 0.f;
+        for (auto i = 1; i <= 2; i++) {
+            auto offset = rack::math::Vec (p [2 * i], p [2 * i + 1]).minus (p0);
+            auto distance = length > 1e-6f
+                ? std::abs (chord.x * offset.y - chord.y * offset.x) / length
+                : offset.norm ();
+            deviation = std::max (deviation, distance);
         }
 
-        return Paint::makeColor (rack::color::MAGENTA);
+        return deviation;
     }
 
-    void getStyle (Style& style, const std::shared_ptr<RackTheme>& themePtr, const NSVGshape* shape) {
-        if (themePtr == nullptr)
-            return;
+    NVGsolidity ThemeableSvg::getEvenOddWinding (const SvgShape& shape, int pathIndex) const {
+        // Compute whether this is a hole or a solid.
+        // Assume that no paths are crossing (usually true for normal SVG graphics).
+        // Also assume that the topology is the same if we use straight lines rather than Beziers (not always
+        // the case but usually true).
+        // Using the even-odd fill rule, if we draw a line from a point on the path to a point outside the
+        // boundary (e.g. top left) and count the number of times it crosses another path, the parity of this
+        // count determines whether the path is a hole (odd) or solid (even).
+        const auto& path = paths [pathIndex];
+        auto pts = &points [2 * path.firstPoint];
+
+        int crossings = 0;
+        auto p0 = rack::math::Vec (pts [0], pts [1]);
+        auto p1 = rack::math::Vec (path.bounds [0] - 1.0, path.bounds [1] - 1.0);
+
+        // Iterate all other paths
+        for (auto path2Index = shape.firstPath; path2Index < shape.firstPath + shape.numPaths; path2Index++) {
+            if (path2Index == pathIndex)
+                continue;
 
-        auto shapeInfo = themeCache.getShapeInfo (shape);
-        auto classStyle = themePtr->getClassStyle (shapeInfo.styleClass);
-        auto idStyle = themePtr->getIdStyle (shapeInfo.shapeId);
+            // Iterate all lines on the path
+            const auto& path2 = paths [path2Index];
+            if (path2.numPoints < 4)
+                continue;
+
+            auto pts2 = &points [2 * path2.firstPoint];
+            for (auto i = 1; i < path2.numPoints + 3; i += 3) {
+                auto p = &pts2 [2 * i];
 
-        // Shape style
-        style = Style ();
+                // The previous point
+                auto p2 = rack::math::Vec (p [-2], p [-1]);
 
-        // Fill
-        style.setFill (getShapePaint (shape->fill));
+                // The current point
+                auto p3 = (i < path2.numPoints)
+                        ? rack::math::Vec (p [4], p [5])
+                        : rack::math::Vec (pts2 [0], pts2 [1]);
 
-        // Stroke
-        style.setStroke (getShapePaint (shape->stroke));
-        style.setStrokeWidth (shape->strokeWidth);
-        style.setStrokeLineCap (static_cast<NVGlineCap> (shape->strokeLineCap));
-        style.setStrokeLineJoin (static_cast<int> (shape->strokeLineJoin));
+                auto crossing = getLineCrossing (p0, p1, p2, p3);
+                auto crossing2 = getLineCrossing (p2, p3, p0, p1);
+                RACK_THEMER_STAT (stats.numCrossingTests++);
+                if (0. <= crossing && crossing < 1. && 0. <= crossing2)
+                    crossings++;
+            }
+        }
 
-        // Combine theme styles
-        if (classStyle != nullptr)
-            style = style.combineStyle (classStyle);
-        if (idStyle != nullptr)
-            style = style.combineStyle (idStyle);
+        return (crossings % 2 == 0) ? NVG_SOLID : NVG_HOLE;
     }
 
-    void ThemeableSvg::draw (NVGcontext* vg, std::shared_ptr<RackTheme> themePtr) {
-        if (vg == nullptr || handle == nullptr)
+    NVGsolidity ThemeableSvg::getNonZeroWinding (int pathIndex) const {
+        // NanoVG fills using the non-zero rule, and reverses any path whose direction doesn't match the winding
+        // it was given. Passing the path's own direction (taken from the signed area of its control polygon, the
+        // same way NanoVG computes it) leaves it untouched, which is exactly what the non-zero rule needs.
+        // An inner path only cuts a hole if it runs the other way, and self-intersecting paths keep whichever
+        // direction their larger loops run in.
+        const auto& path = paths [pathIndex];
+        auto pts = &points [2 * path.firstPoint];
+
+        auto area = 0.f;
+        for (auto i = 2; i < path.numPoints; i++) {
+            auto ax = pts [0], ay = pts [1];
+            auto bx = pts [2 * (i - 1)], by = pts [2 * (i - 1) + 1];
+            auto cx = pts [2 * i], cy = pts [2 * i + 1];
+            area += (bx - ax) * (cy - ay) - (cx - ax) * (by - ay);
+        }
+
+        return area < 0.f ? NVG_HOLE : NVG_SOLID;
+    }
+
+    void ThemeableSvg::buildGeometry () {
+        shapes.clear ();
+        paths.clear ();
+        points.clear ();
+        gradients.clear ();
+        segmentLodTiers.clear ();
+        size = rack::math::Vec ();
+        numPaths = 0;
+        numPoints = 0;
+        memoryUsage = 0;
+        shapeStandIns.clear ();
+        metrics = SvgMetrics ();
+        stats = DrawStats ();
+
+        if (handle == nullptr)
             return;
 
-        int shapeIndex = 0;
-        Style shapeStyle;
+        size = rack::math::Vec (handle->width, handle->height);
 
-        // Iterate shape linked list
-        for (auto shape = handle->shapes; shape; shape = shape->next, shapeIndex++) {
-            // Skip shapes with no paths
-            if (shape->paths == nullptr)
-                continue;
+        // Size the tables up front, so they're each a single allocation.
+        int shapeCount = 0, pathCount = 0, pointCount = 0;
+        for (auto shape = handle->shapes; shape != nullptr; shape = shape->next) {
+            shapeCount++;
 
-            // Visibility
-            if (!(shape->flags & NSVG_FLAGS_VISIBLE))
-                continue;
+            for (auto path = shape->paths; path != nullptr; path = path->next) {
+                pathCount++;
 
-            nvgSave (vg);
-            getStyle (shapeStyle, themePtr, shape);
+                if (path->pts != nullptr)
+                    pointCount += path->npts;
+            }
+        }
 
-            // Opacity
-            auto opacity = shape->opacity * shapeStyle.getOpacity ();
-            if (opacity < 1.0)
-                nvgAlpha (vg, opacity);
+        shapes.reserve (shapeCount);
+        paths.reserve (pathCount);
+        points.reserve (2 * pointCount);
+        segmentLodTiers.reserve (pointCount / 3);
 
-            // Build path
-            nvgBeginPath (vg);
+        for (auto shape = handle->shapes; shape != nullptr; shape = shape->next) {
+            auto& shapeData = shapes.emplace_back ();
+            shapeData.source = shape;
+
+            std::string_view shapeId, styleClass;
+            splitShapeId (shape->id, shapeId, styleClass);
+            shapeData.shapeId = getKeyedString (shapeId);
+            shapeData.styleClass = getKeyedString (styleClass);
+
+            shapeData.visible = (shape->flags & NSVG_FLAGS_VISIBLE) != 0;
+            shapeData.evenOdd = shape->fillRule == NSVG_FILLRULE_EVENODD;
+            shapeData.fillGradient = addGradient (gradients, shape->fill);
+            shapeData.strokeGradient = addGradient (gradients, shape->stroke);
+            shapeData.firstPath = static_cast<int> (paths.size ());
+            std::copy (shape->bounds, shape->bounds + 4, shapeData.bounds);
+
+            shapeData.fill = getSvgPaint (shape->fill);
+            shapeData.stroke = getSvgPaint (shape->stroke);
+            shapeData.opacity = shape->opacity;
+            shapeData.strokeWidth = shape->strokeWidth;
+            shapeData.strokeLineCap = shape->strokeLineCap;
+            shapeData.strokeLineJoin = shape->strokeLineJoin;
+
+            for (auto path = shape->paths; path != nullptr; path = path->next) {
+                numPaths++;
+                numPoints += path->npts / 3;
 
-            // Iterate path linked list
-            for (auto path = shape->paths; path; path = path->next) {
                 // Skip if pts is somehow null
                 if (path->pts == nullptr)
                     continue;
 
-                nvgMoveTo (vg, path->pts [0], path->pts [1]);
-                for (auto i = 1; i < path->npts; i += 3) {
-                    auto p = &path->pts [2 * i];
-                    nvgBezierTo (vg, p [0], p [1], p [2], p [3], p [4], p [5]);
-                }
-
-                // Close path
-                if (path->closed)
-                    nvgClosePath (vg);
-
-                // Compute whether this is a hole or a solid.
-                // Assume that no paths are crossing (usually true for normal SVG graphics).
-                // Also assume that the topology is the same if we use straight lines rather than Beziers (not always
-                // the case but usually true).
-                // Using the even-odd fill rule, if we draw a line from a point on the path to a point outside the
-                // boundary (e.g. top left) and count the number of times it crosses another path, the parity of this
-                // count determines whether the path is a hole (odd) or solid (even).
-                int crossings = 0;
-                auto p0 = rack::math::Vec (path->pts [0], path->pts [1]);
-                auto p1 = rack::math::Vec (path->bounds [0] - 1.0, path->bounds [1] - 1.0);
-
-                // Iterate all other paths
-                for (auto path2 = shape->paths; path2; path2 = path2->next) {
-                    if (path2 == path)
-                        continue;
-
-                    // Iterate all lines on the path
-                    if (path2->npts < 4)
-                        continue;
-
-                    for (auto i = 1; i < path2->npts + 3; i += 3) {
-                        auto p = &path2->pts [2 * i];
-
-                        // The previous point
-                        auto p2 = rack::math::Vec (p [-2], p [-1]);
-
-                        // The current point
-                        auto p3 = (i < path2->npts)
-                                ? rack::math::Vec (p [4], p [5])
-                                : rack::math::Vec (path2->pts [0], path2->pts [1]);
-
-                        auto crossing = getLineCrossing (p0, p1, p2, p3);
-                        auto crossing2 = getLineCrossing (p2, p3, p0, p1);
-                        if (0. <= crossing && crossing < 1. && 0. <= crossing2)
-                            crossings++;
-                    }
-                }
-
-                nvgPathWinding (vg, (crossings % 2 == 0) ? NVG_SOLID : NVG_HOLE);
-            }
+                auto& pathData = paths.emplace_back ();
+                pathData.firstPoint = static_cast<int> (points.size () / 2);
+                pathData.numPoints = path->npts;
+                pathData.firstSegment = static_cast<int> (segmentLodTiers.size ());
+                pathData.closed = path->closed != 0;
+                std::copy (path->bounds, path->bounds + 4, pathData.bounds);
 
-            // Fill shape
-            auto fillPaint = shapeStyle.getFill ();
-            if (!fillPaint.isNone ()) {
-                auto hasGradient =
-                    shape->fill.type == NSVG_PAINT_LINEAR_GRADIENT ||
-                    shape->fill.type == NSVG_PAINT_RADIAL_GRADIENT;
-                if (fillPaint.isGradient () && !hasGradient)
-                    nvgFillColor (vg, getNVGColor (shape->fill.color));
-                else if (fillPaint.isColor ())
-                    nvgFillColor (vg, fillPaint.getColor ());
-                else if (fillPaint.isGradient () && shape->fill.gradient != nullptr)
-                    nvgFillPaint (vg, getGradient (vg, &shape->fill, fillPaint));
-
-                nvgFill (vg);
+                points.insert (points.end (), path->pts, path->pts + 2 * path->npts);
+                for (auto i = 1; i < path->npts; i += 3)
+                    segmentLodTiers.push_back (lod::getTierBelowSize (getCurveDeviation (&path->pts [2 * (i - 1)]), lod::CurveTolerance));
             }
 
-            // Stroke shape
-            auto strokePaint = shapeStyle.getStroke ();
-            if (!strokePaint.isNone ()) {
-                nvgStrokeWidth (vg, shapeStyle.getStrokeWidth ());
-                // strokeDashOffset, strokeDashArray, strokeDashCount not yet supported
-                nvgLineCap (vg, shapeStyle.getStrokeLineCap ());
-                nvgLineJoin (vg, shapeStyle.getStrokeLineJoin ());
-
-                auto hasGradient =
-                    shape->stroke.type == NSVG_PAINT_LINEAR_GRADIENT ||
-                    shape->stroke.type == NSVG_PAINT_RADIAL_GRADIENT;
-                if (strokePaint.isGradient () && !hasGradient)
-                    nvgStrokeColor (vg, getNVGColor (shape->stroke.color));
-                else if (strokePaint.isColor ())
-                    nvgStrokeColor (vg, strokePaint.getColor ());
-                else if (strokePaint.isGradient () && shape->stroke.gradient != nullptr)
-                    nvgStrokePaint (vg, getGradient (vg, &shape->stroke, strokePaint));
-
-                nvgStroke (vg);
+            shapeData.numPaths = static_cast<int> (paths.size ()) - shapeData.firstPath;
+
+            if (shapeData.visible && shapeData.numPaths > 0) {
+                auto extent = std::min (shapeData.bounds [2] - shapeData.bounds [0], shapeData.bounds [3] - shapeData.bounds [1]);
+                if (extent > 0.f)
+                    metrics.minFeatureSize = std::min (metrics.minFeatureSize, extent);
+
+                if (shape->stroke.type != NSVG_PAINT_NONE && shape->strokeWidth > 0.f)
+                    metrics.minStrokeWidth = std::min (metrics.minStrokeWidth, shape->strokeWidth);
             }
+        }
 
-            nvgRestore (vg);
+        metrics.minFeatureSize = std::min (metrics.minFeatureSize, metrics.minStrokeWidth);
+        metrics.numPoints = numPoints;
+
+        // Both the NanoSVG image and the flattened tables are kept around.
+        memoryUsage = sizeof (ThemeableSvg) +
+                      shapeCount * (sizeof (NSVGshape) + sizeof (SvgShape)) +
+                      pathCount * (sizeof (NSVGpath) + sizeof (SvgPath)) +
+                      2 * pointCount * 2 * sizeof (float) +
+                      segmentLodTiers.capacity () * sizeof (uint8_t) +
+                      gradients.capacity () * (sizeof (SvgGradient) + sizeof (NSVGgradient));
+
+        // The windings need the whole shape to be flattened first.
+        for (const auto& shape : shapes) {
+            for (auto pathIndex = shape.firstPath; pathIndex < shape.firstPath + shape.numPaths; pathIndex++) {
+                paths [pathIndex].winding = shape.evenOdd
+                    ? getEvenOddWinding (shape, pathIndex)
+                    : getNonZeroWinding (pathIndex);
+            }
         }
     }
+
+    void ThemeableSvg::draw (NVGcontext* vg, std::shared_ptr<RackTheme> themePtr) { draw (vg, themePtr, rack::math::Rect::inf ()); }
+    void ThemeableSvg::draw (NVGcontext* vg, std::shared_ptr<RackTheme> themePtr, rack::math::Rect clipBox, bool levelOfDetail) {
+        if (vg == nullptr || shapes.empty ())
+            return;
+
+        themeCache.getDrawProgram (*this, themePtr.get ())->replay (vg, clipBox, levelOfDetail);
+    }
 }
@@ -0,0 +1,41 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rack_themer.hpp"
+#include "DrawProgram.hpp"
+#include "ThemeCache.hpp"
+
+namespace rack_themer {
+    DrawStats ThemedSvg::getStats () const {
+        if (svg == nullptr || theme == nullptr)
+            return DrawStats ();
+
+        return themeCache.getDrawProgram (*svg, theme.get ())->getStats ();
+    }
+
+    void ThemedSvg::draw (NVGcontext* vg, rack::math::Rect clipBox, bool levelOfDetail) {
+        if (svg == nullptr || theme == nullptr)
+            return;
+
+        // Only look the program up again when the SVG or the theme have been swapped since the last draw.
+        if (program == nullptr || !program->isCompiledFor (*svg, theme.get ()))
+            program = themeCache.getDrawProgram (*svg, theme.get ());
+
+        program->replay (vg, clipBox, levelOfDetail);
+    }
+}
@@ -18,17 +18,208 @@
  */
 
 #include "rack_themer.hpp"
+#include "FramebufferCache.hpp"
+#include "WorkerPool.hpp"
 
 namespace rack_themer {
 namespace widgets {
     /*
      * SvgWidget
      */
+    void SvgWidget::setSvgAsync (SvgFuture svg, std::function<void (std::shared_ptr<ThemeableSvg>)> onLoad) {
+        pendingSvg = svg;
+        this->onLoad = onLoad;
+    }
+
+    void SvgWidget::step () {
+        if (pendingSvg.valid () && pendingSvg.wait_for (std::chrono::seconds (0)) == std::future_status::ready) {
+            // Loads dropped by a shutdown count as failed.
+            auto loadedSvg = getJobResult (pendingSvg, nullptr);
+            auto callback = std::move (onLoad);
+            pendingSvg = SvgFuture ();
+            onLoad = nullptr;
+
+            // Keep the current SVG if loading failed.
+            if (loadedSvg != nullptr) {
+                if (callback != nullptr) {
+                    callback (loadedSvg);
+                } else {
+                    setSvg (loadedSvg);
+                    if (auto framebuffer = getAncestorOfType<rack::widget::FramebufferWidget> ())
+                        framebuffer->setDirty ();
+                }
+            }
+        }
+
+        Widget::step ();
+    }
+
     void SvgWidget::onThemeChanged (std::shared_ptr<rack_themer::RackTheme> theme) {
         if (autoSwitchTheme)
             svg = svg.withTheme (theme);
     }
 
+    /*
+     * SharedFramebufferWidget
+     */
+    void SharedFramebufferWidget::draw (const DrawArgs& args) {
+        // Draw through the private framebuffer if sharing isn't possible, or directly if already drawing in a framebuffer.
+        if (!shared || bypassed || args.fb != nullptr || keyWidget == nullptr || !keyWidget->svg.isValid ()) {
+            image = nullptr;
+            FramebufferWidget::draw (args);
+            return;
+        }
+
+        float xform [6];
+        nvgCurrentTransform (args.vg, xform);
+
+        // Skew and rotation aren't supported unless rotatable, same as FramebufferWidget.
+        auto rotated = !rack::math::isNear (xform [1], 0.f) || !rack::math::isNear (xform [2], 0.f);
+        if (rotated && !rotatable) {
+            image = nullptr;
+            FramebufferWidget::draw (args);
+            return;
+        }
+
+        // Rotatable images are always rendered unrotated, at the scale of the transform's axes, so every angle shares one.
+        auto scale = getSharedImageScale (xform, rotatable);
+        auto offset = rack::math::Vec (xform [4], xform [5]).round ();
+
+        auto key = SharedFramebufferKey ();
+        key.svgId = keyWidget->svg.svg->getUniqueId ();
+        key.themeId = keyWidget->svg.theme->getUniqueId ();
+        key.ownerType = parent != nullptr ? &typeid (*parent) : &typeid (*this);
+        key.size = box.size;
+        key.scale = scale;
+        key.oversample = oversample;
+        key.pixelRatio = APP->window->pixelRatio;
+
+        // Dirtying only looks the image up again. If it was already rendered by another widget, it can be reused as is.
+        if (dirty || image == nullptr || !(image->key == key)) {
+            dirty = false;
+            image = framebufferCache.getFramebuffer (key);
+            deleteFramebuffer ();
+
+            if (!frames.empty ())
+                prepareFrames (key, scale);
+        }
+
+        if (!image->rendered)
+            renderShared (*image, scale);
+
+        if (image->fb == nullptr)
+            return;
+
+        // Draw rotatable images in local coordinates, and let the transform rotate them. They aren't snapped to whole
+        // pixels at any angle, so they don't jump when the rotation passes zero.
+        if (rotatable) {
+            auto localBox = rack::math::Rect (image->fbBox.pos.div (scale), image->fbBox.size.div (scale));
+
+            nvgBeginPath (args.vg);
+            nvgRect (args.vg, localBox.pos.x, localBox.pos.y, localBox.size.x, localBox.size.y);
+            auto paint = nvgImagePattern (args.vg, localBox.pos.x, localBox.pos.y, localBox.size.x, localBox.size.y, 0.f, image->fb->image, 1.f);
+            nvgFillPaint (args.vg, paint);
+            nvgFill (args.vg);
+            return;
+        }
+
+        // Draw the image using world coordinates. It's snapped to whole pixels, since it's shared by widgets at
+        // different subpixel offsets.
+        nvgSave (args.vg);
+        nvgResetTransform (args.vg);
+
+        auto imageBox = image->fbBox;
+        imageBox.pos = imageBox.pos.plus (offset);
+
+        nvgBeginPath (args.vg);
+        nvgRect (args.vg, imageBox.pos.x, imageBox.pos.y, imageBox.size.x, imageBox.size.y);
+        auto paint = nvgImagePattern (args.vg, imageBox.pos.x, imageBox.pos.y, imageBox.size.x, imageBox.size.y, 0.f, image->fb->image, 1.f);
+        nvgFillPaint (args.vg, paint);
+        nvgFill (args.vg);
+
+        nvgRestore (args.vg);
+    }
+
+    void SharedFramebufferWidget::renderShared (SharedFramebuffer& target, rack::math::Vec scale) {
+        // Don't try again every frame if rendering fails.
+        target.rendered = true;
+
+        auto vg = APP->window->fbVg;
+        auto pixelRatio = APP->window->pixelRatio;
+
+        auto localBox = children.empty () ? box.zeroPos () : getVisibleChildrenBoundingBox ();
+        auto min = localBox.getTopLeft ().mult (scale).floor ();
+        auto max = localBox.getBottomRight ().mult (scale).ceil ();
+        target.fbBox = rack::math::Rect::fromMinMax (min, max);
+
+        auto fbSize = target.fbBox.size.mult (pixelRatio * oversample).ceil ();
+        if (!fbSize.isFinite () || fbSize.isZero ())
+            return;
+
+        target.fb = nvgluCreateFramebuffer (vg, fbSize.x, fbSize.y, 0);
+        if (target.fb == nullptr)
+            return;
+
+        nvgluBindFramebuffer (target.fb);
+
+        nvgBeginFrame (vg, target.fbBox.size.x, target.fbBox.size.y, pixelRatio * oversample);
+        nvgTranslate (vg, -target.fbBox.pos.x, -target.fbBox.pos.y);
+        nvgScale (vg, scale.x, scale.y);
+
+        auto fbArgs = DrawArgs ();
+        fbArgs.vg = vg;
+        fbArgs.clipBox = box.zeroPos ();
+        fbArgs.fb = target.fb;
+        Widget::draw (fbArgs);
+
+        glViewport (0, 0, fbSize.x, fbSize.y);
+        glClearColor (0, 0, 0, 0);
+        glClear (GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        nvgEndFrame (vg);
+
+        nvgluBindFramebuffer (nullptr);
+    }
+
+    void SharedFramebufferWidget::prepareFrames (const SharedFramebufferKey& key, rack::math::Vec scale) {
+        // Render each frame by temporarily showing it in the key widget.
+        auto currentSvg = keyWidget->svg;
+
+        // Fill a new list before replacing the old one, so images both lists hold aren't freed in between.
+        std::vector<std::shared_ptr<SharedFramebuffer>> images;
+        images.reserve (frames.size ());
+        for (const auto& frame : frames) {
+            if (frame == nullptr)
+                continue;
+
+            auto frameKey = key;
+            frameKey.svgId = frame->getUniqueId ();
+
+            auto frameImage = framebufferCache.getFramebuffer (frameKey);
+            if (!frameImage->rendered) {
+                keyWidget->svg = currentSvg.withSvg (frame);
+                renderShared (*frameImage, scale);
+            }
+
+            images.push_back (frameImage);
+        }
+
+        keyWidget->svg = currentSvg;
+        frameImages = std::move (images);
+    }
+
+    void SharedFramebufferWidget::onContextDestroy (const ContextDestroyEvent& e) {
+        // Other widgets may still hold the same images, so they're freed now instead of when the last one lets go,
+        // and are rendered again in the new context by whichever widget draws them next.
+        if (image != nullptr)
+            image->invalidate ();
+        for (const auto& frameImage : frameImages)
+            frameImage->invalidate ();
+
+        image = nullptr;
+        frameImages.clear ();
+        FramebufferWidget::onContextDestroy (e);
+    }
+
     /*
      * SvgPanel
      */
@@ -37,15 +228,44 @@ namespace widgets {
         addChild (framebuffer);
 
         svgWidget = new SvgWidget;
+        svgWidget->clipCulling = true;
+        svgWidget->levelOfDetail = true;
         framebuffer->addChild (svgWidget);
 
         panelBorder = new rack::app::PanelBorder;
         framebuffer->addChild (panelBorder);
     }
 
+    float SvgPanel::getOversample (float zoom, float pixelRatio) {
+        if (forcedOversample > 0.f)
+            return forcedOversample;
+
+        // Never more than the framebuffer's usual factor, which low DPI screens need to draw small details cleanly.
+        auto maxFactor = std::max (std::min (pixelRatio < 2.f ? 2.f : 1.f, maxOversample), 1.f);
+        auto pixelScale = zoom * pixelRatio;
+        if (maxFactor <= 1.f || svgWidget->svg.svg == nullptr || !(pixelScale > 0.f))
+            return maxFactor;
+
+        // Oversample until the thinnest feature covers enough pixels. Wide panels without thin details are drawn as
+        // is, which saves a lot of fill. Panels with few points are mostly large flat areas, where oversampling only
+        // smooths a handful of edges, so they settle for a single pixel.
+        auto metrics = svgWidget->svg.svg->getMetrics ();
+        if (!std::isfinite (metrics.minFeatureSize))
+            return 1.f;
+
+        auto featurePixels = metrics.numPoints <= simplePanelPoints ? 1.f : minFeaturePixels;
+        auto oversample = featurePixels / (metrics.minFeatureSize * pixelScale);
+        // Round up to half steps, so the factor doesn't change (and re-render the panel) on every zoom step.
+        oversample = std::ceil (oversample * 2.f) / 2.f;
+        return rack::math::clamp (oversample, 1.f, maxFactor);
+    }
+
     void SvgPanel::step () {
-        // Small details draw poorly at low DPI, so oversample when drawing to the framebuffer.
-        framebuffer->oversample = APP->window->pixelRatio < 2.0 ? 2.0 : 1.0;
+        auto oversample = getOversample (getAbsoluteZoom (), APP->window->pixelRatio);
+        if (oversample != framebuffer->oversample) {
+            framebuffer->oversample = oversample;
+            framebuffer->setDirty ();
+        }
 
         Widget::step ();
     }
@@ -68,7 +288,7 @@ namespace widgets {
      * SvgPort
      */
     SvgPort::SvgPort () {
-        framebuffer = new rack::widget::FramebufferWidget;
+        framebuffer = new SharedFramebufferWidget;
         addChild (framebuffer);
 
         shadow = new rack::app::CircularShadow;
@@ -78,7 +298,10 @@ namespace widgets {
         shadow->box.size = rack::math::Vec ();
 
         svgWidget = new SvgWidget;
+        svgWidget->clipCulling = true;
+        svgWidget->levelOfDetail = true;
         framebuffer->addChild (svgWidget);
+        framebuffer->keyWidget = svgWidget;
     }
 
     void SvgPort::setSvg (ThemedSvg svg) {
@@ -99,11 +322,14 @@ namespace widgets {
      * SvgScrew
      */
     SvgScrew::SvgScrew () {
-        framebuffer = new rack::widget::FramebufferWidget;
+        framebuffer = new SharedFramebufferWidget;
         addChild (framebuffer);
 
         svgWidget = new SvgWidget;
+        svgWidget->clipCulling = true;
+        svgWidget->levelOfDetail = true;
         framebuffer->addChild (svgWidget);
+        framebuffer->keyWidget = svgWidget;
     }
 
     void SvgScrew::setSvg (ThemedSvg svg) {
@@ -121,7 +347,7 @@ namespace widgets {
      * SvgButton
      */
     SvgButton::SvgButton () {
-        framebuffer = new rack::widget::FramebufferWidget;
+        framebuffer = new SharedFramebufferWidget;
         addChild (framebuffer);
 
         shadow = new rack::app::CircularShadow;
@@ -129,7 +355,10 @@ namespace widgets {
         shadow->box.size = rack::math::Vec ();
 
         svgWidget = new SvgWidget;
+        svgWidget->clipCulling = true;
+        svgWidget->levelOfDetail = true;
         framebuffer->addChild (svgWidget);
+        framebuffer->keyWidget = svgWidget;
     }
 
     void SvgButton::onButton (const ButtonEvent& e) {
@@ -144,6 +373,8 @@ namespace widgets {
 
     void SvgButton::addFrame (std::shared_ptr<ThemeableSvg> svg) {
         frames.push_back (svg);
+        framebuffer->frames.push_back (svg);
+        framebuffer->setDirty ();
 
         // If this is our first frame, automatically set SVG and size.
         if (svgWidget->svg.svg == nullptr) {
@@ -157,21 +388,28 @@ namespace widgets {
         }
     }
 
+    void SvgButton::setFrame (int index) {
+        if (index < 0 || index >= static_cast<int> (frames.size ()))
+            return;
+        if (svgWidget->svg.svg == frames [index])
+            return;
+
+        // The frames are all prerendered, so this only swaps which image the framebuffer draws.
+        svgWidget->setSvg (frames [index]);
+        framebuffer->setDirty ();
+    }
+
     void SvgButton::onDragStart (const DragStartEvent& e) {
         if (e.button != GLFW_MOUSE_BUTTON_LEFT)
             return;
 
-        if (frames.size () >= 2) {
-            svgWidget->setSvg (frames [1]);
-            framebuffer->setDirty ();
-        }
+        if (frames.size () >= 2)
+            setFrame (1);
     }
 
     void SvgButton::onDragEnd (const DragEndEvent& e) {
-        if (frames.size () >= 1) {
-            svgWidget->setSvg (frames [0]);
-            framebuffer->setDirty ();
-        }
+        if (frames.size () >= 1)
+            setFrame (0);
     }
 
     void SvgButton::onDragDrop (const DragDropEvent& e) {
@@ -182,7 +420,7 @@ namespace widgets {
      * SvgSwitch
      */
     SvgSwitch::SvgSwitch () {
-        framebuffer = new rack::widget::FramebufferWidget;
+        framebuffer = new SharedFramebufferWidget;
         addChild (framebuffer);
 
         shadow = new rack::app::CircularShadow;
@@ -190,7 +428,10 @@ namespace widgets {
         shadow->box.size = rack::math::Vec ();
 
         svgWidget = new SvgWidget;
+        svgWidget->clipCulling = true;
+        svgWidget->levelOfDetail = true;
         framebuffer->addChild (svgWidget);
+        framebuffer->keyWidget = svgWidget;
     }
 
     SvgSwitch::~SvgSwitch () {
@@ -198,6 +439,8 @@ namespace widgets {
 
     void SvgSwitch::addFrame (std::shared_ptr<ThemeableSvg> svg) {
         frames.push_back (svg);
+        framebuffer->frames.push_back (svg);
+        framebuffer->setDirty ();
 
         // If this is our first frame, automatically set SVG and size.
         if (svgWidget->svg.svg == nullptr) {
@@ -211,6 +454,17 @@ namespace widgets {
         }
     }
 
+    void SvgSwitch::setFrame (int index) {
+        if (index < 0 || index >= static_cast<int> (frames.size ()))
+            return;
+        if (svgWidget->svg.svg == frames [index])
+            return;
+
+        // The frames are all prerendered, so this only swaps which image the framebuffer draws.
+        svgWidget->setSvg (frames [index]);
+        framebuffer->setDirty ();
+    }
+
     void SvgSwitch::onDragStart (const DragStartEvent& e) {
         Switch::onDragStart (e);
 
@@ -218,10 +472,8 @@ namespace widgets {
             return;
 
         // Set down frame if latch
-        if (latch && frames.size () >= 2) {
-            svgWidget->setSvg (frames [1]);
-            framebuffer->setDirty ();
-        }
+        if (latch && frames.size () >= 2)
+            setFrame (1);
     }
 
     void SvgSwitch::onDragEnd (const DragEndEvent& e) {
@@ -231,12 +483,8 @@ namespace widgets {
             return;
 
         // Set up frame if latch
-        if (latch) {
-            if (frames.size () >= 1) {
-                svgWidget->setSvg (frames [0]);
-                framebuffer->setDirty ();
-            }
-        }
+        if (latch && frames.size () >= 1)
+            setFrame (0);
     }
 
     void SvgSwitch::onChange (const ChangeEvent& e) {
@@ -245,8 +493,7 @@ namespace widgets {
             if (!frames.empty () && pq != nullptr) {
                 auto index = (int) std::round (pq->getValue () - pq->getMinValue ());
                 index = rack::math::clamp (index, 0, (int) frames.size () - 1);
-                svgWidget->setSvg (frames [index]);
-                framebuffer->setDirty ();
+                setFrame (index);
             }
         }
         ParamWidget::onChange (e);
@@ -266,7 +513,9 @@ namespace widgets {
         transformWidget = new rack::widget::TransformWidget;
         framebuffer->addChild (transformWidget);
 
+        // The rotor doesn't cull, since the clip box isn't rotated along with it.
         svgWidget = new SvgWidget;
+        svgWidget->levelOfDetail = true;
         transformWidget->addChild (svgWidget);
     }
 
@@ -277,6 +526,8 @@ namespace widgets {
         svgWidget->setSvg (svg);
         transformWidget->box.size = svgWidget->box.size;
         framebuffer->box.size = svgWidget->box.size;
+        if (rotor != nullptr)
+            rotor->box.size = svgWidget->box.size;
         box.size = svgWidget->box.size;
 
         shadow->box.size = svgWidget->box.size;
@@ -286,6 +537,37 @@ namespace widgets {
         framebuffer->setDirty ();
     }
 
+    void SvgKnob::setFastRotation (bool fastRotation) {
+        if (fastRotation == isFastRotation ())
+            return;
+
+        if (fastRotation) {
+            // Move the SVG out of the framebuffer and into its own rotatable image, drawn over the shadow.
+            framebuffer->removeChild (transformWidget);
+            transformWidget->removeChild (svgWidget);
+
+            rotor = new SharedFramebufferWidget;
+            rotor->rotatable = true;
+            rotor->keyWidget = svgWidget;
+            rotor->box.size = svgWidget->box.size;
+            rotor->addChild (svgWidget);
+
+            transformWidget->addChild (rotor);
+            addChild (transformWidget);
+        } else {
+            removeChild (transformWidget);
+            transformWidget->removeChild (rotor);
+            rotor->removeChild (svgWidget);
+            delete rotor;
+            rotor = nullptr;
+
+            transformWidget->addChild (svgWidget);
+            framebuffer->addChild (transformWidget);
+        }
+
+        framebuffer->setDirty ();
+    }
+
     void SvgKnob::onChange (const ChangeEvent& e) {
         auto angle = 0.f;
 
@@ -308,7 +590,10 @@ namespace widgets {
         transformWidget->translate (center);
         transformWidget->rotate (angle);
         transformWidget->translate (center.neg ());
-        framebuffer->setDirty ();
+
+        // With fast rotation, the framebuffer only holds the shadow, which doesn't change.
+        if (!isFastRotation ())
+            framebuffer->setDirty ();
 
         Knob::onChange (e);
     }
@@ -316,15 +601,64 @@ namespace widgets {
     /*
      * SvgSlider
      */
+
+    /*
+     * The slider's handle. It doesn't draw its SVG itself, but copies it into its own shared framebuffer instead, so
+     * it can be moved through its box like any widget without anything being rendered again.
+     */
+    struct SliderHandle : SvgWidget {
+        SharedFramebufferWidget* framebuffer;
+        SvgWidget* image;
+
+        SliderHandle () {
+            framebuffer = new SharedFramebufferWidget;
+            addChild (framebuffer);
+
+            // The image follows the handle's theme instead of switching on its own.
+            image = new SvgWidget;
+            image->autoSwitchTheme = false;
+            framebuffer->addChild (image);
+            framebuffer->keyWidget = image;
+        }
+
+        void updateImage () {
+            image->clipCulling = clipCulling;
+            image->levelOfDetail = levelOfDetail;
+
+            if (image->svg == svg)
+                return;
+
+            image->setSvg (svg);
+            framebuffer->box.size = image->box.size;
+            framebuffer->setDirty ();
+        }
+
+        void step () override {
+            SvgWidget::step ();
+            updateImage ();
+        }
+
+        void draw (const DrawArgs& args) override { Widget::draw (args); }
+    };
+
     SvgSlider::SvgSlider () {
-        framebuffer = new rack::widget::FramebufferWidget;
+        framebuffer = new SharedFramebufferWidget;
         addChild (framebuffer);
 
         background = new SvgWidget;
+        background->clipCulling = true;
+        background->levelOfDetail = true;
         framebuffer->addChild (background);
+        framebuffer->keyWidget = background;
 
-        handle = new SvgWidget;
-        framebuffer->addChild (handle);
+        // The handle is drawn through its own layer, which moves along with it instead of being re-rendered.
+        auto sliderHandle = new SliderHandle;
+        sliderHandle->clipCulling = true;
+        sliderHandle->levelOfDetail = true;
+        addChild (sliderHandle);
+
+        handle = sliderHandle;
+        handleFramebuffer = sliderHandle->framebuffer;
 
         speed = 2.f;
     }
@@ -345,7 +679,7 @@ namespace widgets {
 
         handle->setSvg (svg);
         handle->box.pos = maxHandlePos;
-        framebuffer->setDirty ();
+        static_cast<SliderHandle*> (handle)->updateImage ();
     }
 
     void SvgSlider::setHandlePos (rack::math::Vec minHandlePos, rack::math::Vec maxHandlePos) {
@@ -371,7 +705,6 @@ namespace widgets {
 
         // Interpolate handle position.
         handle->box.pos = minHandlePos.crossfade (maxHandlePos, v);
-        framebuffer->setDirty ();
 
         ParamWidget::onChange (e);
     }
@@ -0,0 +1,71 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace rack_themer {
+    WorkerPool::~WorkerPool () { shutdown (); }
+
+    void WorkerPool::shutdown () {
+        std::vector<std::thread> stoppedThreads;
+        {
+            std::unique_lock lock (mutex);
+            stopping = true;
+            jobs.clear ();
+            stoppedThreads = std::move (threads);
+            threads.clear ();
+        }
+
+        condition.notify_all ();
+        for (auto& thread : stoppedThreads)
+            thread.join ();
+    }
+
+    int WorkerPool::getNumThreads () {
+        std::unique_lock lock (mutex);
+        return static_cast<int> (threads.size ());
+    }
+
+    void WorkerPool::start () {
+        // Leave the other half of the cores to the audio engine and the UI.
+        auto numThreads = std::max (1u, std::thread::hardware_concurrency () / 2);
+        for (auto i = 0u; i < numThreads; i++)
+            threads.emplace_back ([this] { run (); });
+    }
+
+    void WorkerPool::run () {
+        while (true) {
+            std::function<void ()> job;
+
+            {
+                std::unique_lock lock (mutex);
+                condition.wait (lock, [this] { return stopping || !jobs.empty (); });
+                if (stopping)
+                    return;
+
+                job = std::move (jobs.front ());
+                jobs.pop_front ();
+            }
+
+            job ();
+        }
+    }
+}
\ No newline at end of file
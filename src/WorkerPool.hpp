@@ -0,0 +1,102 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace rack_themer {
+    /*
+     * A fixed set of background threads that run submitted jobs in order. The threads are only started when the
+     * first job is submitted. Jobs still queued when the pool is shut down are dropped, which breaks their futures.
+     * Jobs submitted after that run right away on the calling thread.
+     */
+    struct WorkerPool {
+      private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::function<void ()>> jobs;
+        std::vector<std::thread> threads;
+        bool stopping = false;
+
+        void start ();
+        void run ();
+
+      public:
+        WorkerPool () { }
+        WorkerPool (const WorkerPool&) = delete;
+        ~WorkerPool ();
+
+        int getNumThreads ();
+        // Drops the queued jobs and joins the threads. The destructor does the same, but the global pool must be shut
+        // down before the library is unloaded, since joining threads from a static destructor can deadlock on Windows.
+        void shutdown ();
+
+        template<typename TJob>
+        auto submit (TJob&& job) -> std::future<decltype (job ())> {
+            using TResult = decltype (job ());
+
+            // std::function needs a copyable target, and packaged_task isn't one.
+            auto task = std::make_shared<std::packaged_task<TResult ()>> (std::forward<TJob> (job));
+            auto future = task->get_future ();
+
+            auto queued = false;
+            {
+                std::unique_lock lock (mutex);
+                if (!stopping) {
+                    if (threads.empty ())
+                        start ();
+
+                    jobs.emplace_back ([task] { (*task) (); });
+                    queued = true;
+                }
+            }
+
+            if (queued)
+                condition.notify_one ();
+            else
+                (*task) ();
+
+            return future;
+        }
+    };
+
+    extern WorkerPool workerPool;
+
+    /*
+     * Waits for a submitted job and returns its result, or fallback if the job was dropped by a shutdown before it
+     * could run.
+     */
+    template<typename TFuture>
+    auto getJobResult (TFuture& future, std::decay_t<decltype (future.get ())> fallback) -> std::decay_t<decltype (future.get ())> {
+        try {
+            return future.get ();
+        } catch (const std::future_error&) {
+            return fallback;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "rack_themer.hpp"
+#include "DrawProgram.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace rack_themer;
+
+static int failures = 0;
+
+static void check (bool condition, const std::string& message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message.c_str ());
+    failures++;
+}
+
+// The third square overlaps the second, so it can't join the first. The last one overlaps nothing after the first.
+static const char* OrderSvgText = R"svg(<svg xmlns="http://www.w3.org/2000/svg" width="50" height="20" viewBox="0 0 50 20">
+    <rect id="first" x="0" y="0" width="10" height="10" fill="#ff0000" />
+    <rect id="second" x="5" y="5" width="10" height="10" fill="#0000ff" />
+    <rect id="third" x="10" y="10" width="10" height="10" fill="#ff0000" />
+    <rect id="fourth" x="40" y="0" width="10" height="10" fill="#ff0000" />
+</svg>)svg";
+
+// The last shape's pointed miter reaches up into the square, but its stroke width alone wouldn't.
+static const char* MiterSvgText = R"svg(<svg xmlns="http://www.w3.org/2000/svg" width="50" height="50" viewBox="0 0 50 50">
+    <path id="first" d="M 40 50 L 43 30 L 46 50" fill="none" stroke="#000000" stroke-width="2" stroke-linejoin="miter" />
+    <rect id="square" x="0" y="20" width="10" height="4" fill="#0000ff" />
+    <path id="last" d="M 0 50 L 3 30 L 6 50" fill="none" stroke="#000000" stroke-width="2" stroke-linejoin="miter" />
+</svg>)svg";
+
+namespace rack_themer {
+    struct SvgTests {
+        using Batches = std::vector<std::vector<int>>;
+
+        // Returns the shape indices each command draws, in order.
+        static Batches getBatches (const DrawProgram& program) {
+            Batches batches;
+            for (const auto& command : program.commands) {
+                auto& batch = batches.emplace_back ();
+                for (auto i = command.firstShape; i < command.firstShape + command.numShapes; i++)
+                    batch.push_back (program.shapes [i].shapeIndex);
+            }
+
+            return batches;
+        }
+
+        // Every pair of shapes that may overlap once stroked must be drawn by separate commands, in the SVG's order.
+        static void checkOverlapsInOrder (const ThemeableSvg& svg, const DrawProgram& program, const std::string& name) {
+            std::vector<int> commandIndices (svg.shapes.size (), -1);
+            for (size_t c = 0; c < program.commands.size (); c++) {
+                const auto& command = program.commands [c];
+                for (auto i = command.firstShape; i < command.firstShape + command.numShapes; i++)
+                    commandIndices [program.shapes [i].shapeIndex] = static_cast<int> (c);
+            }
+
+            auto getExtent = [&] (const SvgShape& shape) {
+                auto extent = shape.stroke.type != NSVG_PAINT_NONE ? 5.f * shape.strokeWidth : 0.f;
+                return rack::math::Rect::fromMinMax (
+                    rack::math::Vec (shape.bounds [0] - extent, shape.bounds [1] - extent),
+                    rack::math::Vec (shape.bounds [2] + extent, shape.bounds [3] + extent)
+                );
+            };
+
+            for (size_t i = 0; i < svg.shapes.size (); i++) {
+                for (size_t j = i + 1; j < svg.shapes.size (); j++) {
+                    if (!getExtent (svg.shapes [i]).intersects (getExtent (svg.shapes [j])))
+                        continue;
+
+                    check (commandIndices [i] < commandIndices [j], name + ": shape " + std::to_string (i) + " is drawn before shape " + std::to_string (j));
+                }
+            }
+        }
+    };
+}
+
+static std::shared_ptr<DrawProgram> compileText (const std::filesystem::path& directory, const std::string& name, const char* text, std::shared_ptr<ThemeableSvg>& svg) {
+    auto svgPath = (directory / (name + ".svg")).string ();
+    std::ofstream (svgPath) << text;
+
+    svg = loadSvg (svgPath);
+    check (svg != nullptr, name + ": the SVG loads");
+    if (svg == nullptr)
+        return nullptr;
+
+    return DrawProgram::compile (*svg, nullptr, DrawProgram::resolveStyles (*svg, nullptr));
+}
+
+// Shapes with the same style are only batched together when no shape drawn in between overlaps them.
+static void testOrder (const std::filesystem::path& directory) {
+    std::shared_ptr<ThemeableSvg> svg;
+    auto program = compileText (directory, "order", OrderSvgText, svg);
+    if (program == nullptr)
+        return;
+
+    check (SvgTests::getBatches (*program) == SvgTests::Batches { { 0 }, { 1 }, { 2, 3 } }, "order: only the shape overlapping nothing joins a batch");
+    SvgTests::checkOverlapsInOrder (*svg, *program, "order");
+}
+
+// Strokes with miter joins can reach well past their width, which must keep them from moving past shapes they cover.
+static void testMiterJoins (const std::filesystem::path& directory) {
+    std::shared_ptr<ThemeableSvg> svg;
+    auto program = compileText (directory, "miter", MiterSvgText, svg);
+    if (program == nullptr)
+        return;
+
+    check (SvgTests::getBatches (*program) == SvgTests::Batches { { 0 }, { 1 }, { 2 } }, "miter: the mitered stroke stays above the square");
+    SvgTests::checkOverlapsInOrder (*svg, *program, "miter");
+}
+
+int main () {
+    // Parse the SVGs every time, rather than loading whatever an earlier run left in the cache.
+    setParseCacheEnabled (false);
+
+    auto directory = std::filesystem::temp_directory_path () / "rack-themer-draw-program-test";
+    std::filesystem::create_directories (directory);
+
+    testOrder (directory);
+    testMiterJoins (directory);
+
+    std::filesystem::remove_all (directory);
+
+    if (failures == 0)
+        std::printf ("All DrawProgram tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FramebufferCache.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace rack_themer;
+
+static int failures = 0;
+
+static void check (bool condition, const std::string& message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message.c_str ());
+    failures++;
+}
+
+struct TestKnob { };
+
+// Same as nvgTransformPremultiply, which is how NanoVG applies nvgScale, nvgTranslate and nvgRotate.
+static void premultiply (float t [6], const float s [6]) {
+    float r [6];
+    r [0] = s [0] * t [0] + s [1] * t [2];
+    r [1] = s [0] * t [1] + s [1] * t [3];
+    r [2] = s [2] * t [0] + s [3] * t [2];
+    r [3] = s [2] * t [1] + s [3] * t [3];
+    r [4] = s [4] * t [0] + s [5] * t [2] + t [4];
+    r [5] = s [4] * t [1] + s [5] * t [3] + t [5];
+    std::copy (r, r + 6, t);
+}
+
+// Builds the transform a knob's rotor is drawn with: the rack's zoom, then the knob's position, then its rotation.
+static void getKnobTransform (float xform [6], float zoom, float angle) {
+    float identity [6] = { 1.f, 0.f, 0.f, 1.f, 0.f, 0.f };
+    std::copy (identity, identity + 6, xform);
+
+    float scale [6] = { zoom, 0.f, 0.f, zoom, 0.f, 0.f };
+    float translate [6] = { 1.f, 0.f, 0.f, 1.f, 123.4f, 56.7f };
+    float rotate [6] = { std::cos (angle), std::sin (angle), -std::sin (angle), std::cos (angle), 0.f, 0.f };
+    premultiply (xform, scale);
+    premultiply (xform, translate);
+    premultiply (xform, rotate);
+}
+
+// Turning a knob all the way around must keep drawing the one image rendered for its zoom.
+static void testFullTurn (float zoom) {
+    auto name = "zoom " + std::to_string (zoom);
+
+    std::vector<std::shared_ptr<SharedFramebuffer>> images;
+    for (int degrees = 0; degrees < 360; degrees++) {
+        float xform [6];
+        getKnobTransform (xform, zoom, degrees * float (M_PI) / 180.f);
+
+        auto key = SharedFramebufferKey ();
+        key.svgId = 1;
+        key.themeId = 1;
+        key.ownerType = &typeid (TestKnob);
+        key.size = rack::math::Vec (20.f, 20.f);
+        key.scale = getSharedImageScale (xform, true);
+        images.push_back (framebufferCache.getFramebuffer (key));
+
+        check (rack::math::isNear (key.scale.x, zoom, 1e-3f) && rack::math::isNear (key.scale.y, zoom, 1e-3f), name + ": the image is rendered at the zoom");
+    }
+
+    check (framebufferCache.getNumFramebuffers () == 1, name + ": only one image is created");
+    for (const auto& image : images)
+        check (image == images.front (), name + ": every angle draws the same image");
+}
+
+int main () {
+    for (auto zoom : { 0.5f, 1.f, 1.5f, 2.25f, std::pow (2.f, 0.3f), 3.7f })
+        testFullTurn (zoom);
+
+    check (framebufferCache.getNumFramebuffers () == 0, "images no widget holds are removed");
+
+    if (failures == 0)
+        std::printf ("All FramebufferCache tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
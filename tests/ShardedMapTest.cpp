@@ -0,0 +1,173 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShardedMap.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace rack_themer;
+using namespace std::chrono_literals;
+
+static int failures = 0;
+
+static void check (bool condition, const char* message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message);
+    failures++;
+}
+
+// Many threads asking for the same keys at once must only ever make each value once.
+static void testCreatesOnce () {
+    constexpr int NumKeys = 256;
+    constexpr int NumThreads = 8;
+    constexpr int NumIterations = 20000;
+
+    ShardedMap<int, int> map;
+    std::vector<std::atomic<int>> createCounts (NumKeys);
+    std::atomic<int> wrongValues = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumThreads; t++) {
+        threads.emplace_back ([&, t] {
+            for (int i = 0; i < NumIterations; i++) {
+                auto key = (i * 7 + t * 13) % NumKeys;
+                auto value = map.getOrCreate (key, [&] (int& value) {
+                    createCounts [key]++;
+                    std::this_thread::yield ();
+                    value = key * 2;
+                    return true;
+                });
+
+                if (value != key * 2)
+                    wrongValues++;
+
+                // Readers, writers and erasers of other tables' kinds of use, mixed in.
+                auto found = 0;
+                if (map.find ((key + 1) % NumKeys, found) && found != ((key + 1) % NumKeys) * 2)
+                    wrongValues++;
+                if (i % 1000 == 0)
+                    map.forEach ([&] (int key, int value) { if (value != key * 2) wrongValues++; });
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join ();
+
+    auto allOnce = true;
+    for (auto& count : createCounts)
+        allOnce &= count == 1;
+
+    check (allOnce, "every value is created exactly once");
+    check (wrongValues == 0, "every caller gets the created value");
+}
+
+// A value that takes long to make must not hold up lookups or creation of any other key, and callers asking for the
+// same key must wait for it instead of making their own.
+static void testSlowCreateDoesntBlock () {
+    constexpr int NumKeys = 64;
+
+    ShardedMap<int, int> map;
+    for (int key = 1; key < NumKeys; key++)
+        map.set (key, key);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    auto started = false;
+    auto release = false;
+    std::atomic<int> slowCreates = 0;
+
+    auto slowCreate = [&] (int& value) {
+        slowCreates++;
+
+        std::unique_lock lock (mutex);
+        started = true;
+        condition.notify_all ();
+        condition.wait (lock, [&] { return release; });
+
+        value = 1000;
+        return true;
+    };
+
+    auto slow = std::async (std::launch::async, [&] { return map.getOrCreate (0, slowCreate); });
+    {
+        std::unique_lock lock (mutex);
+        condition.wait (lock, [&] { return started; });
+    }
+
+    auto waiter = std::async (std::launch::async, [&] { return map.getOrCreate (0, slowCreate); });
+
+    // Every shard holds some of these keys, including the one being made.
+    auto others = std::async (std::launch::async, [&] {
+        auto ok = true;
+        for (int key = 1; key < NumKeys; key++) {
+            auto value = 0;
+            ok &= map.find (key, value) && value == key;
+            ok &= map.getOrCreate (key + NumKeys, [&] (int& value) { value = key; return true; }) == key;
+        }
+
+        return ok;
+    });
+
+    auto othersFinished = others.wait_for (5s) == std::future_status::ready;
+    check (othersFinished, "other keys can be read and created while a value is being made");
+    check (waiter.wait_for (50ms) == std::future_status::timeout, "callers asking for the same key wait for it");
+
+    {
+        std::unique_lock lock (mutex);
+        release = true;
+    }
+    condition.notify_all ();
+
+    check (othersFinished && others.get (), "other keys return their own values");
+    check (slow.get () == 1000 && waiter.get () == 1000, "callers waiting on a key get its value");
+    check (slowCreates == 1, "a key being made isn't made again");
+}
+
+// Values that create chooses not to store are made again by the next caller.
+static void testFailedCreatesArentStored () {
+    ShardedMap<int, int> map;
+    auto attempts = 0;
+
+    for (int i = 0; i < 3; i++)
+        map.getOrCreate (1, [&] (int& value) { attempts++; return false; });
+
+    auto value = 0;
+    check (attempts == 3, "failed creates are retried");
+    check (!map.find (1, value), "failed creates aren't stored");
+}
+
+int main () {
+    testCreatesOnce ();
+    testSlowCreateDoesntBlock ();
+    testFailedCreatesArentStored ();
+
+    if (failures == 0)
+        std::printf ("All ShardedMap tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
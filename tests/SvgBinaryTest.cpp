@@ -0,0 +1,258 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rack_themer.hpp"
+#include "SvgBinary.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace rack_themer;
+
+static int failures = 0;
+
+static void check (bool condition, const std::string& message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message.c_str ());
+    failures++;
+}
+
+// Covers hidden shapes, both fill rules with holes, curves, strokes, both kinds of gradient, and themeable ids.
+static const char* SvgText = R"svg(<svg xmlns="http://www.w3.org/2000/svg" width="60" height="40" viewBox="0 0 60 40">
+    <defs>
+        <linearGradient id="linear" x1="0" y1="0" x2="1" y2="0">
+            <stop offset="0" stop-color="#3f7837" />
+            <stop offset="0.5" stop-color="#ffffff" />
+            <stop offset="1" stop-color="#a01466" />
+        </linearGradient>
+        <radialGradient id="radial" cx="0.5" cy="0.5" r="0.5">
+            <stop offset="0" stop-color="#ee2e63" />
+            <stop offset="1" stop-color="#323232" />
+        </radialGradient>
+    </defs>
+    <rect id="background--theme-background" width="60" height="40" fill="url(#linear)" stroke="#808080" stroke-width="0.5" />
+    <path id="ring--theme-bezel" fill-rule="evenodd" fill="#999999" d="M 5 5 H 25 V 25 H 5 Z M 10 10 H 20 V 20 H 10 Z" />
+    <path id="nonzero-ring" fill="#3d3d3d" d="M 30 5 H 50 V 25 H 30 Z M 35 10 V 20 H 45 V 10 Z" />
+    <circle id="knob--theme-knob" cx="15" cy="32" r="5" fill="url(#radial)" stroke="#1a1a1a" stroke-linecap="round" stroke-linejoin="bevel" />
+    <path id="curve" fill="none" stroke="#000000" stroke-width="0.25" stroke-linecap="square" d="M 30 35 C 35 28 45 42 55 35" />
+    <rect id="hidden" x="40" y="28" width="5" height="5" fill="#ff0000" style="display:none" />
+    <rect id="translucent" x="50" y="28" width="5" height="5" fill="#0000ff" opacity="0.5" />
+</svg>)svg";
+
+namespace rack_themer {
+    /*
+     * Compares the tables of two SVGs field by field.
+     */
+    struct SvgTests {
+        static bool isSameBounds (const float* lhs, const float* rhs) { return std::memcmp (lhs, rhs, 4 * sizeof (float)) == 0; }
+
+        static void checkPaint (const SvgPaint& expected, const SvgPaint& actual, const std::string& name) {
+            check (expected.type == actual.type, name + " type matches");
+            check (expected.color == actual.color, name + " color matches");
+            check (expected.numStops == actual.numStops, name + " stop count matches");
+            check (expected.firstStopColor == actual.firstStopColor, name + " first stop matches");
+            check (expected.lastStopColor == actual.lastStopColor, name + " last stop matches");
+        }
+
+        static void checkShapes (const ThemeableSvg& expected, const ThemeableSvg& actual) {
+            check (expected.shapes.size () == actual.shapes.size (), "the shape count matches");
+            if (expected.shapes.size () != actual.shapes.size ())
+                return;
+
+            for (size_t i = 0; i < expected.shapes.size (); i++) {
+                const auto& lhs = expected.shapes [i];
+                const auto& rhs = actual.shapes [i];
+                auto name = "shape " + std::to_string (i);
+
+                check (std::strcmp (lhs.source->id, rhs.source->id) == 0, name + ": id matches");
+                check (lhs.source->flags == rhs.source->flags, name + ": source flags match");
+                check (lhs.source->fillRule == rhs.source->fillRule, name + ": source fill rule matches");
+                check (isSameBounds (lhs.source->bounds, rhs.source->bounds), name + ": source bounds match");
+
+                check (lhs.shapeId == rhs.shapeId, name + ": shape id matches");
+                check (lhs.styleClass == rhs.styleClass, name + ": style class matches");
+                check (lhs.visible == rhs.visible, name + ": visibility matches");
+                check (lhs.evenOdd == rhs.evenOdd, name + ": fill rule matches");
+                check (lhs.fillGradient == rhs.fillGradient, name + ": fill gradient matches");
+                check (lhs.strokeGradient == rhs.strokeGradient, name + ": stroke gradient matches");
+                check (lhs.firstPath == rhs.firstPath && lhs.numPaths == rhs.numPaths, name + ": path range matches");
+                check (isSameBounds (lhs.bounds, rhs.bounds), name + ": bounds match");
+
+                checkPaint (lhs.fill, rhs.fill, name + ": fill");
+                checkPaint (lhs.stroke, rhs.stroke, name + ": stroke");
+                check (lhs.opacity == rhs.opacity, name + ": opacity matches");
+                check (lhs.strokeWidth == rhs.strokeWidth, name + ": stroke width matches");
+                check (lhs.strokeLineCap == rhs.strokeLineCap, name + ": line cap matches");
+                check (lhs.strokeLineJoin == rhs.strokeLineJoin, name + ": line join matches");
+            }
+        }
+
+        static void checkPaths (const ThemeableSvg& expected, const ThemeableSvg& actual) {
+            check (expected.paths.size () == actual.paths.size (), "the path count matches");
+            if (expected.paths.size () != actual.paths.size ())
+                return;
+
+            for (size_t i = 0; i < expected.paths.size (); i++) {
+                const auto& lhs = expected.paths [i];
+                const auto& rhs = actual.paths [i];
+                auto name = "path " + std::to_string (i);
+
+                check (lhs.firstPoint == rhs.firstPoint && lhs.numPoints == rhs.numPoints, name + ": point range matches");
+                check (lhs.firstSegment == rhs.firstSegment, name + ": first segment matches");
+                check (lhs.closed == rhs.closed, name + ": closed flag matches");
+                check (lhs.winding == rhs.winding, name + ": winding matches");
+                check (isSameBounds (lhs.bounds, rhs.bounds), name + ": bounds match");
+            }
+        }
+
+        static void checkGradients (const ThemeableSvg& expected, const ThemeableSvg& actual) {
+            check (expected.gradients.size () == actual.gradients.size (), "the gradient count matches");
+            if (expected.gradients.size () != actual.gradients.size ())
+                return;
+
+            for (size_t i = 0; i < expected.gradients.size (); i++) {
+                const auto& lhs = expected.gradients [i];
+                const auto& rhs = actual.gradients [i];
+                auto name = "gradient " + std::to_string (i);
+
+                check (lhs.radial == rhs.radial, name + ": kind matches");
+                check (lhs.start == rhs.start && lhs.end == rhs.end && lhs.radius == rhs.radius, name + ": geometry matches");
+            }
+        }
+
+        static void checkTables (const ThemeableSvg& expected, const ThemeableSvg& actual) {
+            check (expected.size == actual.size, "the size matches");
+            check (expected.numPaths == actual.numPaths, "the original path count matches");
+            check (expected.numPoints == actual.numPoints, "the original point count matches");
+            check (expected.metrics.minFeatureSize == actual.metrics.minFeatureSize, "the thinnest feature matches");
+            check (expected.metrics.minStrokeWidth == actual.metrics.minStrokeWidth, "the thinnest stroke matches");
+            check (expected.metrics.numPoints == actual.metrics.numPoints, "the point metric matches");
+
+            checkShapes (expected, actual);
+            checkPaths (expected, actual);
+            checkGradients (expected, actual);
+            check (expected.points == actual.points, "the point table matches");
+            check (expected.segmentLodTiers == actual.segmentLodTiers, "the level of detail tiers match");
+        }
+
+        // Compiles the SVG with one path's record changed, then puts the path back.
+        static std::vector<uint8_t> serializeWithPath (ThemeableSvg& svg, size_t pathIndex, int numPoints, int firstSegment) {
+            auto& path = svg.paths [pathIndex];
+            auto original = path;
+
+            path.numPoints = numPoints;
+            path.firstSegment = firstSegment;
+            auto binary = SvgBinary::serialize (svg);
+
+            path = original;
+            return binary;
+        }
+
+        static int getNumSegments (const ThemeableSvg& svg) { return static_cast<int> (svg.segmentLodTiers.size ()); }
+        static const SvgPath& getPath (const ThemeableSvg& svg, size_t pathIndex) { return svg.paths [pathIndex]; }
+
+        static bool hasHole (const ThemeableSvg& svg) {
+            for (const auto& path : svg.paths) {
+                if (path.winding == NVG_HOLE)
+                    return true;
+            }
+
+            return false;
+        }
+    };
+}
+
+// A compiled SVG must load back into exactly the tables it was compiled from.
+static void testRoundTrip (const std::string& svgPath) {
+    auto loaded = loadSvg (svgPath);
+    check (loaded != nullptr, "the SVG loads");
+    if (loaded == nullptr)
+        return;
+
+    check (SvgTests::hasHole (*loaded), "the SVG has holes to compare");
+
+    auto binary = SvgBinary::serialize (*loaded);
+    auto roundTripped = SvgBinary::deserialize (binary.data (), binary.size ());
+    check (roundTripped != nullptr, "the compiled SVG loads");
+    if (roundTripped == nullptr)
+        return;
+
+    SvgTests::checkTables (*loaded, *roundTripped);
+    check (SvgBinary::serialize (*roundTripped) == binary, "compiling it again gives the same binary");
+
+    // The source's size and hash are kept, so outdated binaries can be told apart.
+    auto sourceHash = uint64_t (0);
+    auto sourceSize = size_t (0);
+    auto withSource = SvgBinary::serialize (*loaded, 0x0123456789ABCDEF, 4567);
+    check (!SvgBinary::getSource (binary.data (), binary.size (), sourceHash, sourceSize), "binaries without a source don't report one");
+    check (SvgBinary::getSource (withSource.data (), withSource.size (), sourceHash, sourceSize) &&
+           sourceHash == 0x0123456789ABCDEF && sourceSize == 4567, "the source's size and hash are kept");
+
+    // Compiled SVGs of another version, or cut short, are rejected rather than misread.
+    check (SvgBinary::deserialize (binary.data (), binary.size () / 2) == nullptr, "truncated binaries are rejected");
+    binary [4] ^= 0xFF;
+    check (SvgBinary::deserialize (binary.data (), binary.size ()) == nullptr, "binaries of other versions are rejected");
+}
+
+// Paths whose points or tiers don't fit the tables are rejected, since drawing them would read past the tables.
+static void testCorruptPaths (const std::string& svgPath) {
+    auto loaded = loadSvg (svgPath);
+    if (loaded == nullptr)
+        return;
+
+    auto& svg = *loaded;
+    const auto& path = SvgTests::getPath (svg, 0);
+    auto numPoints = path.numPoints;
+    auto firstSegment = path.firstSegment;
+
+    auto isRejected = [&] (int numPoints, int firstSegment) {
+        auto binary = SvgTests::serializeWithPath (svg, 0, numPoints, firstSegment);
+        return SvgBinary::deserialize (binary.data (), binary.size ()) == nullptr;
+    };
+
+    check (!isRejected (numPoints, firstSegment), "unchanged paths are accepted");
+    check (isRejected (0, firstSegment), "paths without points are rejected");
+    check (isRejected (2, firstSegment), "paths with a partial curve are rejected");
+    check (isRejected (numPoints - 1, firstSegment), "paths missing the end of their last curve are rejected");
+    check (isRejected (numPoints, SvgTests::getNumSegments (svg) - (numPoints - 1) / 3 + 1), "paths whose tiers run past the table are rejected");
+}
+
+int main () {
+    // Parse the SVG every time, rather than loading whatever an earlier run left in the cache.
+    setParseCacheEnabled (false);
+
+    auto directory = std::filesystem::temp_directory_path () / "rack-themer-svg-binary-test";
+    std::filesystem::create_directories (directory);
+    auto svgPath = (directory / "panel.svg").string ();
+    std::ofstream (svgPath) << SvgText;
+
+    testRoundTrip (svgPath);
+    testCorruptPaths (svgPath);
+
+    std::filesystem::remove_all (directory);
+
+    if (failures == 0)
+        std::printf ("All SvgBinary tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rack_themer.hpp"
+#include "ThemeBinary.hpp"
+#include "ThemeLoader.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace rack_themer;
+
+static int failures = 0;
+
+static void check (bool condition, const std::string& message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message.c_str ());
+    failures++;
+}
+
+// Covers every kind of paint, each optional attribute both set and unset, and gradients with one or two stops.
+static const char* ThemeJson = R"({
+    "name": "Round trip",
+    "styles": {
+        "plain": { },
+        "color-fill": { "fill": "#3f783780", "stroke": "none" },
+        "stroke-only": { "stroke": { "color": "#323232", "width": 1.5, "line_cap": "round" } },
+        "two-stops": {
+            "fill": {
+                "gradient": [
+                    { "index": 0, "color": "#3f7837", "offset": 0.25 },
+                    { "index": 1, "color": "#a01466", "offset": 0.75 }
+                ]
+            },
+            "opacity": 0.5
+        },
+        "second-stop-only": { "stroke": { "gradient": [ { "index": 1, "color": "#a01466" } ] } },
+        ".shape-id": { "fill": "none", "stroke": { "color": "#808080", "width": 0.25, "line_cap": "square" } },
+        ".gradient-id": { "fill": { "gradient": [ { "index": 0, "color": "#ee2e63" } ] }, "opacity": 0 }
+    }
+})";
+
+static const char* ClassNames [] = { "plain", "color-fill", "stroke-only", "two-stops", "second-stop-only", "shape-id", "missing" };
+static const char* IdNames [] = { "shape-id", "gradient-id", "plain", "missing" };
+
+static bool isSameColor (const NVGcolor& lhs, const NVGcolor& rhs) {
+    return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+}
+
+static void checkPaint (const Paint& expected, const Paint& actual, const std::string& name) {
+    check (expected.Kind () == actual.Kind (), name + ": paint kind matches");
+    if (expected.Kind () != actual.Kind ())
+        return;
+
+    if (expected.isColor ())
+        check (isSameColor (expected.getColor (), actual.getColor ()), name + ": color matches");
+
+    if (expected.isGradient ()) {
+        auto expectedGradient = expected.getGradient ();
+        auto actualGradient = actual.getGradient ();
+
+        check (expectedGradient->nstops == actualGradient->nstops, name + ": gradient stop count matches");
+        for (int i = 0; i < 2; i++) {
+            const auto& expectedStop = expectedGradient->stops [i];
+            const auto& actualStop = actualGradient->stops [i];
+            auto stopName = name + ": gradient stop " + std::to_string (i);
+
+            check (expectedStop.index == actualStop.index, stopName + " index matches");
+            check (expectedStop.offset == actualStop.offset, stopName + " offset matches");
+            check (isSameColor (expectedStop.color, actualStop.color), stopName + " color matches");
+        }
+    }
+}
+
+static void checkStyle (const std::shared_ptr<Style>& expected, const std::shared_ptr<Style>& actual, const std::string& name) {
+    check ((expected == nullptr) == (actual == nullptr), name + ": present in both or neither");
+    if (expected == nullptr || actual == nullptr)
+        return;
+
+    checkPaint (expected->getFill (), actual->getFill (), name + " fill");
+    checkPaint (expected->getStroke (), actual->getStroke (), name + " stroke");
+
+    check (expected->hasOpacity () == actual->hasOpacity (), name + ": opacity flag matches");
+    check (expected->hasStrokeWidth () == actual->hasStrokeWidth (), name + ": stroke width flag matches");
+    check (expected->hasStrokeLineCap () == actual->hasStrokeLineCap (), name + ": line cap flag matches");
+    check (expected->hasStrokeLineJoin () == actual->hasStrokeLineJoin (), name + ": line join flag matches");
+
+    check (expected->getOpacity () == actual->getOpacity (), name + ": opacity matches");
+    check (expected->getStrokeWidth () == actual->getStrokeWidth (), name + ": stroke width matches");
+    check (expected->getStrokeLineCap () == actual->getStrokeLineCap (), name + ": line cap matches");
+    check (expected->getStrokeLineJoin () == actual->getStrokeLineJoin (), name + ": line join matches");
+}
+
+// A compiled theme must load back into exactly the theme it was compiled from.
+static void testRoundTrip () {
+    auto loaded = themeLoader.loadTheme (ThemeJson, std::strlen (ThemeJson));
+    check (loaded != nullptr, "the theme loads");
+    if (loaded == nullptr)
+        return;
+
+    auto binary = ThemeBinary::serialize (*loaded);
+    auto roundTripped = ThemeBinary::deserialize (binary.data (), binary.size ());
+    check (roundTripped != nullptr, "the compiled theme loads");
+    if (roundTripped == nullptr)
+        return;
+
+    check (loaded->getName () == roundTripped->getName (), "the name matches");
+
+    for (auto name : ClassNames) {
+        auto key = getKeyedString (name);
+        checkStyle (loaded->getClassStyle (key), roundTripped->getClassStyle (key), std::string ("class ") + name);
+    }
+
+    for (auto name : IdNames) {
+        auto key = getKeyedString (name);
+        checkStyle (loaded->getIdStyle (key), roundTripped->getIdStyle (key), std::string ("id ") + name);
+    }
+
+    // The source's size and hash are kept, so outdated binaries can be told apart.
+    auto sourceHash = uint64_t (0);
+    auto sourceSize = size_t (0);
+    auto withSource = ThemeBinary::serialize (*loaded, 0x0123456789ABCDEF, 4567);
+    check (!ThemeBinary::getSource (binary.data (), binary.size (), sourceHash, sourceSize), "binaries without a source don't report one");
+    check (ThemeBinary::getSource (withSource.data (), withSource.size (), sourceHash, sourceSize) &&
+           sourceHash == 0x0123456789ABCDEF && sourceSize == 4567, "the source's size and hash are kept");
+
+    // Compiled themes of another version, or cut short, are rejected rather than misread.
+    check (ThemeBinary::deserialize (binary.data (), binary.size () / 2) == nullptr, "truncated binaries are rejected");
+    binary [4] ^= 0xFF;
+    check (ThemeBinary::deserialize (binary.data (), binary.size ()) == nullptr, "binaries of other versions are rejected");
+}
+
+int main () {
+    themeLoader.setLogger ([] (logging::Severity severity, logging::ErrorCode code, std::string info) { });
+
+    testRoundTrip ();
+
+    if (failures == 0)
+        std::printf ("All ThemeBinary tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "rack_themer.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace rack_themer;
+
+static int failures = 0;
+
+static void check (bool condition, const std::string& message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message.c_str ());
+    failures++;
+}
+
+// Each shape but the last is a square drawn clockwise on screen, with a smaller square inside it.
+static const char* SvgText = R"svg(<svg xmlns="http://www.w3.org/2000/svg" width="100" height="50" viewBox="0 0 100 50">
+    <path id="nonzero-reversed" fill="#000000" d="M 0 0 H 20 V 20 H 0 Z M 5 5 V 15 H 15 V 5 Z" />
+    <path id="nonzero-same" fill="#000000" d="M 25 0 H 45 V 20 H 25 Z M 30 5 H 40 V 15 H 30 Z" />
+    <path id="evenodd-same" fill="#000000" fill-rule="evenodd" d="M 50 0 H 70 V 20 H 50 Z M 56 5 H 66 V 15 H 56 Z" />
+    <path id="nonzero-counter-clockwise" fill="#000000" d="M 75 0 V 20 H 95 V 0 Z" />
+</svg>)svg";
+
+namespace rack_themer {
+    struct SvgTests {
+        static std::vector<NVGsolidity> getWindings (const ThemeableSvg& svg, size_t shapeIndex) {
+            std::vector<NVGsolidity> windings;
+            if (shapeIndex >= svg.shapes.size ())
+                return windings;
+
+            const auto& shape = svg.shapes [shapeIndex];
+            for (auto i = shape.firstPath; i < shape.firstPath + shape.numPaths; i++)
+                windings.push_back (svg.paths [i].winding);
+
+            return windings;
+        }
+    };
+}
+
+static void testWindings (const ThemeableSvg& svg) {
+    using Windings = std::vector<NVGsolidity>;
+
+    // Non-zero filled paths keep their own direction, so an inner path only cuts a hole if it runs the other way.
+    check (SvgTests::getWindings (svg, 0) == Windings { NVG_SOLID, NVG_HOLE }, "reversed inner paths of non-zero shapes are holes");
+    check (SvgTests::getWindings (svg, 1) == Windings { NVG_SOLID, NVG_SOLID }, "inner paths of non-zero shapes running the same way are filled");
+
+    // Even-odd filled paths are holes when they're nested an odd number of times, whichever way they run.
+    check (SvgTests::getWindings (svg, 2) == Windings { NVG_SOLID, NVG_HOLE }, "inner paths of even-odd shapes are holes");
+
+    // A path on its own is filled either way, but keeps its direction.
+    check (SvgTests::getWindings (svg, 3) == Windings { NVG_HOLE }, "lone counter-clockwise paths keep their direction");
+}
+
+int main () {
+    // Parse the SVG every time, rather than loading whatever an earlier run left in the cache.
+    setParseCacheEnabled (false);
+
+    auto directory = std::filesystem::temp_directory_path () / "rack-themer-winding-test";
+    std::filesystem::create_directories (directory);
+    auto svgPath = (directory / "windings.svg").string ();
+    std::ofstream (svgPath) << SvgText;
+
+    auto svg = loadSvg (svgPath);
+    check (svg != nullptr, "the SVG loads");
+    if (svg != nullptr)
+        testWindings (*svg);
+
+    std::filesystem::remove_all (directory);
+
+    if (failures == 0)
+        std::printf ("All winding tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
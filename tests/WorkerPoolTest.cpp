@@ -0,0 +1,117 @@
+/*
+ *  RackThemer
+ *  Copyright (C) 2024 Chronos "phantombeta" Ouroboros
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "WorkerPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace rack_themer;
+using namespace std::chrono_literals;
+
+static int failures = 0;
+
+static void check (bool condition, const char* message) {
+    if (condition)
+        return;
+
+    std::fprintf (stderr, "FAILED: %s\n", message);
+    failures++;
+}
+
+// Jobs still queued when the pool shuts down must never run, and waiting on them must report the fallback.
+static void testDropsQueuedJobs () {
+    WorkerPool pool;
+
+    // Keep every thread busy, so the jobs submitted after these stay queued.
+    std::atomic<int> numStarted = 0;
+    std::atomic<bool> release = false;
+    auto block = [&] {
+        numStarted++;
+        while (!release)
+            std::this_thread::sleep_for (1ms);
+        return 1;
+    };
+
+    std::vector<std::future<int>> blockers;
+    blockers.push_back (pool.submit (block));
+    for (auto i = 1; i < pool.getNumThreads (); i++)
+        blockers.push_back (pool.submit (block));
+
+    while (numStarted < pool.getNumThreads ())
+        std::this_thread::sleep_for (1ms);
+
+    std::atomic<int> numDroppedRun = 0;
+    std::vector<std::future<int>> queued;
+    for (auto i = 0; i < 8; i++)
+        queued.push_back (pool.submit ([&] { numDroppedRun++; return 1; }));
+
+    // Only release the threads once the queue has been dropped, which is when new jobs start running inline.
+    std::thread releaser ([&] {
+        auto callerId = std::this_thread::get_id ();
+        while (true) {
+            auto probe = pool.submit ([] { return std::this_thread::get_id (); });
+            if (getJobResult (probe, std::thread::id ()) == callerId)
+                break;
+        }
+
+        release = true;
+    });
+
+    pool.shutdown ();
+    releaser.join ();
+
+    auto blockerResults = 0;
+    for (auto& blocker : blockers)
+        blockerResults += getJobResult (blocker, 0);
+    check (blockerResults == static_cast<int> (blockers.size ()), "jobs already running finish");
+
+    auto droppedResults = 0;
+    for (auto& job : queued)
+        droppedResults += getJobResult (job, -1);
+    check (droppedResults == -static_cast<int> (queued.size ()), "dropped jobs give the fallback instead of throwing");
+    check (numDroppedRun == 0, "dropped jobs never run");
+    check (pool.getNumThreads () == 0, "the threads are joined");
+}
+
+// After shutting down, jobs run on the calling thread before submit returns.
+static void testRunsInlineAfterShutdown () {
+    WorkerPool pool;
+    pool.submit ([] { }).wait ();
+    pool.shutdown ();
+
+    auto callerId = std::this_thread::get_id ();
+    auto future = pool.submit ([] { return std::this_thread::get_id (); });
+    check (future.wait_for (0s) == std::future_status::ready, "jobs submitted after shutting down are done right away");
+    check (getJobResult (future, std::thread::id ()) == callerId, "jobs submitted after shutting down run on the caller");
+}
+
+int main () {
+    testDropsQueuedJobs ();
+    testRunsInlineAfterShutdown ();
+
+    if (failures == 0)
+        std::printf ("All WorkerPool tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file